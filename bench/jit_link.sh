@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+#
+# Link time and resident memory of the two JIT linkers over many small
+# modules: every declaration and top level expression is its own object.
+#
+# Usage: bench/jit_link.sh <path to yapl> [number of functions]
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl> [number of functions]}
+COUNT=${2:-10000}
+
+SCRIPT=$(mktemp --suffix=.yapl)
+trap 'rm -f "$SCRIPT"' EXIT
+
+for ((i = 0; i < COUNT; i++)); do
+    echo "int f$i(int x) { return x + $i; }"
+    echo "f$i(1);"
+done > "$SCRIPT"
+
+for linker in rtdyld jitlink; do
+    echo "=== --jit-linker=$linker, $((COUNT * 2)) modules ==="
+    /usr/bin/time -f "wall: %e s, max rss: %M KB" \
+        "$YAPL" --jit-linker="$linker" --time-report --stats "$SCRIPT" 2>&1 >/dev/null \
+        | grep -E "^(wall|total) | jit "
+done
@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+#
+# Execution time of a vectorizable loop sum, in YAPL and in C.
+#
+# Usage: bench/loop_sum.sh <path to yapl> [iterations]
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl> [iterations]}
+N=${2:-200000000}
+CC=${CC:-cc}
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+cat > "$WORKDIR/loop_sum.yapl" <<YAPL
+int kernel(int n, int k) {
+    int s = 0;
+    for (int i = 0; i < n; i = i + 1) {
+        s = s + ((i * i - k * i) < k);
+    }
+    return s;
+}
+kernel($N, 100000);
+YAPL
+
+cat > "$WORKDIR/loop_sum.c" <<C
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+__attribute__((noinline)) int kernel(int n, int k) {
+    int s = 0;
+    for (int i = 0; i < n; i = i + 1) {
+        s = s + ((i * i - k * i) < k);
+    }
+    return s;
+}
+
+int main(int argc, char **argv) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int result = kernel(atoi(argv[1]), 100000);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("C:    %d in %.3f ms\n", result,
+           (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    return 0;
+}
+C
+
+# -fwrapv: YAPL integers wrap around on overflow.
+"$CC" -O3 -march=native -fwrapv "$WORKDIR/loop_sum.c" -o "$WORKDIR/loop_sum"
+"$WORKDIR/loop_sum" "$N"
+
+"$YAPL" --time-report "$WORKDIR/loop_sum.yapl" 2>&1 | awk '
+    /^Evaluated to/ { result = $3 }
+    /^total / { printf "YAPL: %s in %s ms (execute phase)\n", result, $6 }'
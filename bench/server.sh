@@ -0,0 +1,61 @@
+#!/usr/bin/env bash
+#
+# Wall time of running a small script for many clients at once:
+#  - server: each client is a session of one `yapl --server`,
+#  - processes: each client is a `yapl` process of its own.
+#
+# Usage: bench/server.sh <path to yapl> [clients]
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl> [clients]}
+CLIENTS=${2:-16}
+
+WORKDIR=$(mktemp -d)
+SOCKET=$WORKDIR/yapl.sock
+SERVER=
+
+cleanup() {
+    [ -n "$SERVER" ] && kill "$SERVER" 2>/dev/null
+    rm -rf "$WORKDIR"
+}
+trap cleanup EXIT
+
+cat > "$WORKDIR/job.yapl" <<'YAPL'
+int fib(int n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+float scale(float x) { return x * 2.5 + 1.0; }
+
+fib(25);
+scale(4.0);
+YAPL
+
+# Wall time in ms of running CLIENTS times the given command at once.
+measure() {
+    local start end
+
+    start=$(date +%s%N)
+    for ((i = 0; i < CLIENTS; i++)); do
+        "$@" "$WORKDIR/job.yapl" >/dev/null 2>&1 &
+    done
+    wait
+    end=$(date +%s%N)
+
+    awk -v ns=$((end - start)) 'BEGIN { printf "%.3f", ns / 1e6 }'
+}
+
+"$YAPL" -q --server="$SOCKET" 2>/dev/null &
+SERVER=$!
+
+while [ ! -S "$SOCKET" ]; do
+    sleep 0.05
+done
+
+echo "server:    $(measure "$YAPL" --connect="$SOCKET") ms for $CLIENTS clients"
+echo "processes: $(measure "$YAPL" -q) ms for $CLIENTS clients"
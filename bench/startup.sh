@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+#
+# Startup latency of yapl, averaged over several runs:
+#  - first prompt: the REPL starts, prints its prompt and reads an empty input,
+#  - first result: a single expression is compiled and evaluated.
+#
+# Usage: bench/startup.sh <path to yapl> [runs]
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl> [runs]}
+RUNS=${2:-50}
+
+# Mean wall time in ms of running yapl RUNS times with the given input.
+measure() {
+    local input=$1
+    local start end
+
+    start=$(date +%s%N)
+    for ((i = 0; i < RUNS; i++)); do
+        printf "%s" "$input" | "$YAPL" >/dev/null 2>&1
+    done
+    end=$(date +%s%N)
+
+    awk -v ns=$((end - start)) -v runs="$RUNS" 'BEGIN { printf "%.3f", ns / runs / 1e6 }'
+}
+
+echo "time to first prompt: $(measure "") ms"
+echo "time to first result: $(measure "1 + 2;") ms"
@@ -0,0 +1,100 @@
+//
+// Calls YAPL functions from C++ through the embedding API, exits with 1 if
+// a result or an error is not the expected one.
+//
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Embedding/YAPLEngine.hpp"
+#include "Logger/Logger.hpp"
+
+static const char *s_Source = R"(
+int square(int x) { return x * x; }
+
+float scale(float x, float factor) { return x * factor; }
+)";
+
+static bool check(bool condition, const char *message) {
+    if (!condition) {
+        std::cerr << "FAIL: " << message << std::endl;
+    }
+
+    return condition;
+}
+
+int main() {
+    // No IR dumps nor compiler messages besides the errors.
+    Logger::setLevel(LogLevel::Error);
+
+    auto engine = YAPLEngine::compile(s_Source);
+
+    if (!engine) {
+        llvm::logAllUnhandledErrors(engine.takeError(), llvm::errs(), "Failed to compile: ");
+        return 1;
+    }
+
+    bool ok = true;
+
+    auto square = (*engine)->getFunction<int(int)>("square");
+
+    if (!square) {
+        llvm::logAllUnhandledErrors(square.takeError(), llvm::errs(), "Failed to get square: ");
+        return 1;
+    }
+
+    ok &= check((*square)(7) == 49, "square(7) == 49");
+
+    auto scale = (*engine)->getFunction<double(double, double)>("scale");
+    ok &= check(scale && (*scale)(1.5, 4.0) == 6.0, "scale(1.5, 4.0) == 6.0");
+
+    if (!scale) {
+        llvm::consumeError(scale.takeError());
+    }
+
+    // The YAPL signature is int(int).
+    auto mismatch = (*engine)->getFunction<double(int)>("square");
+    ok &= check(!mismatch, "square as double(int) is rejected");
+
+    if (!mismatch) {
+        llvm::consumeError(mismatch.takeError());
+    }
+
+    auto missing = (*engine)->getFunction<int(int)>("cube");
+    ok &= check(!missing, "an undefined function is rejected");
+
+    if (!missing) {
+        llvm::consumeError(missing.takeError());
+    }
+
+    auto squares = (*engine)->getBatchFunction<int(int)>("square");
+
+    if (!squares) {
+        llvm::logAllUnhandledErrors(squares.takeError(), llvm::errs(), "Failed to get the batch square: ");
+        return 1;
+    }
+
+    std::vector<int> input = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    std::vector<int> output(input.size());
+
+    (*squares)(input.data(), output.data(), input.size());
+
+    for (size_t i = 0; i < input.size(); i++) {
+        ok &= check(output[i] == input[i] * input[i], "batch square");
+    }
+
+    // Top level expressions are not accepted.
+    auto expression = YAPLEngine::compile("1 + 2;");
+    ok &= check(!expression, "a top level expression is rejected");
+
+    if (!expression) {
+        llvm::consumeError(expression.takeError());
+    }
+
+    if (ok) {
+        std::cout << "embedding: all checks passed" << std::endl;
+    }
+
+    return ok ? 0 : 1;
+}
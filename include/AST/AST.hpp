@@ -4,5 +4,6 @@
 
 #pragma once
 
+#include "ControlFlowAST.hpp"
 #include "DeclarationAST.hpp"
 #include "ExprAST.hpp"
@@ -0,0 +1,151 @@
+//
+// Statements of function bodies.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ExprAST.hpp"
+
+inline Statistic NumAssignExprAST{"ast", "NumAssignExprAST", "Number of AssignExprAST allocated"};
+inline Statistic NumForExprAST{"ast", "NumForExprAST", "Number of ForExprAST allocated"};
+inline Statistic NumWhileExprAST{"ast", "NumWhileExprAST", "Number of WhileExprAST allocated"};
+inline Statistic NumParallelForExprAST{"ast", "NumParallelForExprAST", "Number of ParallelForExprAST allocated"};
+inline Statistic NumIfExprAST{"ast", "NumIfExprAST", "Number of IfExprAST allocated"};
+inline Statistic NumConditionalExprAST{"ast", "NumConditionalExprAST", "Number of ConditionalExprAST allocated"};
+inline Statistic NumReturnExprAST{"ast", "NumReturnExprAST", "Number of ReturnExprAST allocated"};
+
+class AssignExprAST : public ExprAST {
+private:
+    std::string m_Name;
+    std::shared_ptr<ExprAST> m_Value;
+public:
+    AssignExprAST(const std::string &mName, std::shared_ptr<ExprAST> mValue)
+        : ExprAST(mValue->getType()), m_Name(mName), m_Value(std::move(mValue))
+    {
+        ++NumAssignExprAST;
+    }
+
+    const std::string &getName() const { return m_Name; }
+    const std::shared_ptr<ExprAST> &getValue() const { return m_Value; }
+};
+
+// for (init; condition; step) { body }
+class ForExprAST : public ExprAST {
+private:
+    std::shared_ptr<ExprAST> m_Init;
+    std::shared_ptr<ExprAST> m_Condition;
+    std::shared_ptr<ExprAST> m_Step;
+    std::vector<std::shared_ptr<ExprAST>> m_Body;
+public:
+    ForExprAST(std::shared_ptr<ExprAST> mInit, std::shared_ptr<ExprAST> mCondition,
+               std::shared_ptr<ExprAST> mStep, std::vector<std::shared_ptr<ExprAST>> mBody)
+        : ExprAST("void"), m_Init(std::move(mInit)), m_Condition(std::move(mCondition)),
+          m_Step(std::move(mStep)), m_Body(std::move(mBody))
+    {
+        ++NumForExprAST;
+    }
+
+    const std::shared_ptr<ExprAST> &getInit() const { return m_Init; }
+    const std::shared_ptr<ExprAST> &getCondition() const { return m_Condition; }
+    const std::shared_ptr<ExprAST> &getStep() const { return m_Step; }
+    const std::vector<std::shared_ptr<ExprAST>> &getBody() const { return m_Body; }
+};
+
+// while (condition) { body }
+class WhileExprAST : public ExprAST {
+private:
+    std::shared_ptr<ExprAST> m_Condition;
+    std::vector<std::shared_ptr<ExprAST>> m_Body;
+public:
+    WhileExprAST(std::shared_ptr<ExprAST> mCondition, std::vector<std::shared_ptr<ExprAST>> mBody)
+        : ExprAST("void"), m_Condition(std::move(mCondition)), m_Body(std::move(mBody))
+    {
+        ++NumWhileExprAST;
+    }
+
+    const std::shared_ptr<ExprAST> &getCondition() const { return m_Condition; }
+    const std::vector<std::shared_ptr<ExprAST>> &getBody() const { return m_Body; }
+};
+
+// parallel for (type i = begin; i < end; i = i + 1) { body }, the iterations
+// run concurrently. end is evaluated once, before the loop.
+class ParallelForExprAST : public ExprAST {
+private:
+    std::string m_Variable;
+    std::string m_VariableType;
+    std::shared_ptr<ExprAST> m_Begin;
+    std::shared_ptr<ExprAST> m_End;
+    std::vector<std::shared_ptr<ExprAST>> m_Body;
+public:
+    ParallelForExprAST(const std::string &mVariable, const std::string &mVariableType,
+                       std::shared_ptr<ExprAST> mBegin, std::shared_ptr<ExprAST> mEnd,
+                       std::vector<std::shared_ptr<ExprAST>> mBody)
+        : ExprAST("void"), m_Variable(mVariable), m_VariableType(mVariableType),
+          m_Begin(std::move(mBegin)), m_End(std::move(mEnd)), m_Body(std::move(mBody))
+    {
+        ++NumParallelForExprAST;
+    }
+
+    const std::string &getVariable() const { return m_Variable; }
+    const std::string &getVariableType() const { return m_VariableType; }
+    const std::shared_ptr<ExprAST> &getBegin() const { return m_Begin; }
+    const std::shared_ptr<ExprAST> &getEnd() const { return m_End; }
+    const std::vector<std::shared_ptr<ExprAST>> &getBody() const { return m_Body; }
+};
+
+// if (condition) { then } else { else }, the else body may be empty.
+class IfExprAST : public ExprAST {
+private:
+    std::shared_ptr<ExprAST> m_Condition;
+    std::vector<std::shared_ptr<ExprAST>> m_Then;
+    std::vector<std::shared_ptr<ExprAST>> m_Else;
+public:
+    IfExprAST(std::shared_ptr<ExprAST> mCondition, std::vector<std::shared_ptr<ExprAST>> mThen,
+              std::vector<std::shared_ptr<ExprAST>> mElse)
+        : ExprAST("void"), m_Condition(std::move(mCondition)), m_Then(std::move(mThen)), m_Else(std::move(mElse))
+    {
+        ++NumIfExprAST;
+    }
+
+    const std::shared_ptr<ExprAST> &getCondition() const { return m_Condition; }
+    const std::vector<std::shared_ptr<ExprAST>> &getThen() const { return m_Then; }
+    const std::vector<std::shared_ptr<ExprAST>> &getElse() const { return m_Else; }
+};
+
+// condition ? then : else, only the selected operand is evaluated.
+class ConditionalExprAST : public ExprAST {
+private:
+    std::shared_ptr<ExprAST> m_Condition;
+    std::shared_ptr<ExprAST> m_Then;
+    std::shared_ptr<ExprAST> m_Else;
+public:
+    ConditionalExprAST(std::shared_ptr<ExprAST> mCondition, std::shared_ptr<ExprAST> mThen,
+                       std::shared_ptr<ExprAST> mElse)
+        : ExprAST(mThen->getType()), m_Condition(std::move(mCondition)), m_Then(std::move(mThen)),
+          m_Else(std::move(mElse))
+    {
+        ++NumConditionalExprAST;
+    }
+
+    const std::shared_ptr<ExprAST> &getCondition() const { return m_Condition; }
+    const std::shared_ptr<ExprAST> &getThen() const { return m_Then; }
+    const std::shared_ptr<ExprAST> &getElse() const { return m_Else; }
+};
+
+// return value; before the end of a function body.
+class ReturnExprAST : public ExprAST {
+private:
+    std::shared_ptr<ExprAST> m_Value;
+public:
+    explicit ReturnExprAST(std::shared_ptr<ExprAST> mValue)
+        : ExprAST(mValue->getType()), m_Value(std::move(mValue))
+    {
+        ++NumReturnExprAST;
+    }
+
+    const std::shared_ptr<ExprAST> &getValue() const { return m_Value; }
+};
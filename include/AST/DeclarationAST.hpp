@@ -4,22 +4,40 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <string>
 
 #include "ExprAST.hpp"
 
+// Definitions and prototypes are also counted as declarations.
+inline Statistic NumDeclarationAST{"ast", "NumDeclarationAST", "Number of DeclarationAST allocated"};
+inline Statistic NumPrototypeAST{"ast", "NumPrototypeAST", "Number of PrototypeAST allocated"};
+inline Statistic NumFunctionDefinitionAST{"ast", "NumFunctionDefinitionAST", "Number of FunctionDefinitionAST allocated"};
+inline Statistic NumVariableDefinitionAST{"ast", "NumVariableDefinitionAST", "Number of VariableDefinitionAST allocated"};
+inline Statistic NumAnonExprAst{"ast", "NumAnonExprAst", "Number of AnonExprAst allocated"};
+
 class DeclarationAST: public ExprAST {
 protected:
     std::string m_Name;
 public:
     DeclarationAST(const std::string &mType, const std::string &mName)
         : ExprAST(mType), m_Name(mName)
-    {}
+    {
+        ++NumDeclarationAST;
+    }
 
     DeclarationAST()
         : ExprAST("int"), m_Name("")
-    {}
+    {
+        ++NumDeclarationAST;
+    }
+
+    DeclarationAST(const DeclarationAST &declaration)
+        : ExprAST(declaration), m_Name(declaration.m_Name)
+    {
+        ++NumDeclarationAST;
+    }
 
     const std::string &getName() const {
         return m_Name;
@@ -29,16 +47,27 @@ public:
 class PrototypeAST : public DeclarationAST {
 protected:
     std::vector<std::shared_ptr<DeclarationAST>> m_Params;
+    // Keywords written before the declaration, such as fastmath.
+    std::vector<std::string> m_Attributes;
 public:
     PrototypeAST(std::shared_ptr<DeclarationAST> declaration,
                  std::vector<std::shared_ptr<DeclarationAST>> mParams)
             : DeclarationAST(*declaration.get()),
               m_Params(std::move(mParams))
-    {}
+    {
+        ++NumPrototypeAST;
+    }
 
     const std::vector<std::shared_ptr<DeclarationAST>> &getParams() const {
         return m_Params;
     }
+
+    void addAttribute(const std::string &attribute) { m_Attributes.push_back(attribute); }
+    const std::vector<std::string> &getAttributes() const { return m_Attributes; }
+
+    bool hasAttribute(const std::string &attribute) const {
+        return std::find(m_Attributes.begin(), m_Attributes.end(), attribute) != m_Attributes.end();
+    }
 };
 
 class FunctionDefinitionAST: public DeclarationAST {
@@ -53,20 +82,28 @@ public:
         :
             DeclarationAST(proto->getType(), proto->getName()), m_Blocks(std::move(blocks)),
             m_ReturnBlock(std::move(returnBlock)), m_Prototype(std::move(proto))
-    {}
+    {
+        ++NumFunctionDefinitionAST;
+        setLocation(m_Prototype->getLine(), m_Prototype->getColumn());
+    }
 
     const std::shared_ptr<PrototypeAST> &getPrototype() const { return m_Prototype; }
+    const std::vector<std::shared_ptr<ExprAST>> &getBlocks() const { return m_Blocks; }
     const std::shared_ptr<ExprAST> &getReturnExpr() const { return m_ReturnBlock; }
 };
 
 class VariableDefinitionAST : public DeclarationAST {
 private:
-    std::shared_ptr<NumberExprAST> m_Value;
+    std::shared_ptr<ExprAST> m_Value;
 public:
     VariableDefinitionAST(const std::string &mType, const std::string &mName,
-                          std::shared_ptr<NumberExprAST> mValue)
+                          std::shared_ptr<ExprAST> mValue)
     : DeclarationAST(mType, mName), m_Value(std::move(mValue))
-    {}
+    {
+        ++NumVariableDefinitionAST;
+    }
+
+    const std::shared_ptr<ExprAST> &getValue() const { return m_Value; }
 };
 
 class AnonExprAst: public ExprAST {
@@ -76,7 +113,10 @@ private:
 public:
     AnonExprAst(std::shared_ptr<ExprAST> expr, std::shared_ptr<PrototypeAST> proto)
         :ExprAST(proto->getType()), m_Expr(expr), m_Proto(proto)
-    {}
+    {
+        ++NumAnonExprAst;
+        setLocation(m_Expr->getLine(), m_Expr->getColumn());
+    }
 
     std::shared_ptr<ExprAST> getExpr() { return m_Expr; }
     std::shared_ptr<PrototypeAST> getProto() { return m_Proto; }
@@ -4,13 +4,27 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "Statistics/Statistics.hpp"
+
+inline Statistic NumVariableExprAST{"ast", "NumVariableExprAST", "Number of VariableExprAST allocated"};
+inline Statistic NumIntExprAST{"ast", "NumIntExprAST", "Number of IntExprAST allocated"};
+inline Statistic NumFloatExprAST{"ast", "NumFloatExprAST", "Number of FloatExprAST allocated"};
+inline Statistic NumBinaryOpExprAST{"ast", "NumBinaryOpExprAST", "Number of BinaryOpExprAST allocated"};
+inline Statistic NumCallFunctionExprAST{"ast", "NumCallFunctionExprAST", "Number of CallFunctionExprAST allocated"};
+inline Statistic NumCastExprAST{"ast", "NumCastExprAST", "Number of CastExprAST allocated"};
+inline Statistic NumVectorExprAST{"ast", "NumVectorExprAST", "Number of VectorExprAST allocated"};
+
 class ExprAST {
 private:
     std::string m_Type;
+    // Source location, 0 when unknown.
+    int m_Line = 0;
+    int m_Column = 0;
 public:
     ExprAST(std::string type)
         : m_Type(type)
@@ -19,6 +33,10 @@ public:
     virtual ~ExprAST() = default;
 
     const std::string getType() const { return m_Type; }
+
+    void setLocation(int line, int column) { m_Line = line; m_Column = column; }
+    int getLine() const { return m_Line; }
+    int getColumn() const { return m_Column; }
 };
 
 class EOFExprAST : public ExprAST {
@@ -28,22 +46,37 @@ public:
     {}
 };
 
+// REPL command such as `#stats`, not part of the program.
+class CommandAST : public ExprAST {
+private:
+    std::string m_Name;
+public:
+    CommandAST(const std::string &mName)
+        : ExprAST("void"), m_Name(mName)
+    {}
+
+    const std::string &getName() const { return m_Name; }
+};
+
 class VariableExprAST : public ExprAST {
 private:
     std::string m_Identifier;
 public:
     VariableExprAST(std::string type, const std::string &mIdentifier)
         : ExprAST(type), m_Identifier(mIdentifier)
-    {}
+    {
+        ++NumVariableExprAST;
+    }
 
     const std::string &getIdentifier() const { return m_Identifier; }
 };
 
 class NumberExprAST : public ExprAST {
 protected:
+    // Held at the widest precision, narrowed to the literal's type when lowered.
     union num{
-        int ival;
-        float fval;
+        int64_t ival;
+        double fval;
     };
 public:
     NumberExprAST(std::string type)
@@ -56,9 +89,10 @@ class IntExprAST: public NumberExprAST {
 private:
     num m_Value;
 public:
-    IntExprAST(int value)
-        : NumberExprAST("int") 
+    IntExprAST(int64_t value, const std::string &type = "int")
+        : NumberExprAST(type)
     {
+        ++NumIntExprAST;
         m_Value.ival = value;
     }
 
@@ -71,9 +105,10 @@ class FloatExprAST: public NumberExprAST {
 private:
     num m_Value;
 public:
-    FloatExprAST(double value)
-        : NumberExprAST("float")
+    FloatExprAST(double value, const std::string &type = "float")
+        : NumberExprAST(type)
     {
+        ++NumFloatExprAST;
         m_Value.fval = value;
     }
 
@@ -82,23 +117,62 @@ public:
     }
 };
 
+// Vector literal: [e0, e1, ...], of type "<element type>[<count>]".
+class VectorExprAST : public ExprAST {
+private:
+    std::vector<std::shared_ptr<ExprAST>> m_Elements;
+public:
+    VectorExprAST(const std::string &type, std::vector<std::shared_ptr<ExprAST>> mElements)
+        : ExprAST(type), m_Elements(std::move(mElements))
+    {
+        ++NumVectorExprAST;
+    }
+
+    const std::vector<std::shared_ptr<ExprAST>> &getElements() const { return m_Elements; }
+};
+
 class BinaryOpExprAST: public ExprAST {
 private:
-    char m_Op;
+    // An ASCII character or a token such as tok_cmp_le.
+    int m_Op;
     std::shared_ptr<ExprAST> m_LHS;
     std::shared_ptr<ExprAST> m_RHS;
+
+    // A scalar operand is broadcast to the other, vector, operand.
+    static std::string resultType(const ExprAST &LHS, const ExprAST &RHS) {
+        bool isLHSVector = LHS.getType().find('[') != std::string::npos;
+        bool isRHSVector = RHS.getType().find('[') != std::string::npos;
+
+        return !isLHSVector && isRHSVector ? RHS.getType() : LHS.getType();
+    }
 public:
-    BinaryOpExprAST(char op,
+    BinaryOpExprAST(int op,
                     std::shared_ptr<ExprAST> LHS,
                     std::shared_ptr<ExprAST> RHS)
-        :ExprAST(LHS->getType()), m_Op(op), m_LHS(std::move(LHS)), m_RHS(std::move(RHS))
-    {}
+        :ExprAST(resultType(*LHS, *RHS)), m_Op(op), m_LHS(std::move(LHS)), m_RHS(std::move(RHS))
+    {
+        ++NumBinaryOpExprAST;
+    }
 
-    const char &getOp() const { return m_Op; }
+    int getOp() const { return m_Op; }
     const std::shared_ptr<ExprAST> &getLHS() const { return m_LHS; }
     const std::shared_ptr<ExprAST> &getRHS() const { return m_RHS; }
 };
 
+// type(value), converts between numeric types of the same vector width.
+class CastExprAST: public ExprAST {
+private:
+    std::shared_ptr<ExprAST> m_Value;
+public:
+    CastExprAST(const std::string &type, std::shared_ptr<ExprAST> mValue)
+        : ExprAST(type), m_Value(std::move(mValue))
+    {
+        ++NumCastExprAST;
+    }
+
+    const std::shared_ptr<ExprAST> &getValue() const { return m_Value; }
+};
+
 class CallFunctionExprAST: public ExprAST {
 private:
     std::string m_Callee;
@@ -107,7 +181,9 @@ public:
     CallFunctionExprAST(const std::string &type, const std::string &mCallee,
                         std::vector<std::shared_ptr<ExprAST>> mArgs)
         :ExprAST(type) ,m_Callee(mCallee),  m_Args(std::move(mArgs))
-    {}
+    {
+        ++NumCallFunctionExprAST;
+    }
 
     const std::string &getCallee() const { return m_Callee; }
     const std::vector<std::shared_ptr<ExprAST>> &getArgs() const { return m_Args; }
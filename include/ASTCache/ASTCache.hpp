@@ -0,0 +1,42 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AST/AST.hpp"
+
+/*
+ * Binary cache of the parsed AST of a file, written next to it as
+ * <file>c, such as script.yaplc for script.yapl.
+ *
+ * The file is made of flat arrays without pointers, so it is read in place
+ * from its memory mapping: a header, the string table of every identifier
+ * and type name, the node records, the children lists, the top level
+ * entries, then the characters of the strings. Nodes are stored children
+ * first and refer to each other by index. The header holds the hash of the
+ * source the cache was written from, a cache whose hash or format version
+ * does not match is ignored.
+ *
+ * The format uses the byte order of the host, a cache written by another
+ * one is rejected as stale.
+ */
+class ASTCache {
+public:
+    // Written to the header, to be incremented whenever the AST changes.
+    static constexpr uint32_t s_FormatVersion = 1;
+
+    static std::string getCachePath(const std::string &sourcePath);
+    static uint64_t hashSource(llvm::StringRef source);
+
+    // The top level entries of the cache at path, an error if it does not
+    // exist, is stale or is corrupted.
+    static llvm::Expected<std::vector<std::shared_ptr<ExprAST>>> read(const std::string &path, uint64_t sourceHash);
+
+    static llvm::Error write(const std::string &path, uint64_t sourceHash,
+                             const std::vector<std::shared_ptr<ExprAST>> &entries);
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+ * Timing of a JIT compiled function, for --bench.
+ *
+ * The function is run through a loop calling it a given number of times.
+ * The loop is first run for a warm-up time, while calibrating the number
+ * of calls of a sample to last s_SampleTime. The samples are then timed
+ * until s_MaxTime, between s_MinSamples and s_MaxSamples of them.
+ */
+class Benchmark {
+public:
+    // Calls the benchmarked function iterations times, at least once.
+    using Loop = void (*)(int64_t iterations);
+
+    struct Result {
+        int64_t iterations = 0;
+        unsigned samples = 0;
+        double meanNs = 0;
+        double stddevNs = 0;
+        double minNs = 0;
+        // Negative when the cycle counter is unavailable.
+        double cycles = -1;
+    };
+
+    static constexpr double s_WarmupTime = 0.1;
+    static constexpr double s_SampleTime = 0.01;
+    static constexpr double s_MaxTime = 1;
+    static constexpr unsigned s_MinSamples = 5;
+    static constexpr unsigned s_MaxSamples = 50;
+
+    static Result run(Loop loop);
+    static void print(std::ostream &stream, const std::string &call, const Result &result);
+};
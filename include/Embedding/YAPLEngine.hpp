@@ -0,0 +1,90 @@
+#pragma once
+
+#include <llvm/Support/Error.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils/options.hpp"
+
+class IRGenerator;
+
+/*
+ * Embedding API: compiles YAPL source once and hands out native function
+ * pointers the host can call directly, with no lookup nor output per call.
+ *
+ *     auto engine = llvm::cantFail(YAPLEngine::compile("int square(int x) { return x * x; }"));
+ *     auto square = llvm::cantFail(engine->getFunction<int(int)>("square"));
+ *
+ * The pointers stay valid as long as the engine lives.
+ */
+
+// YAPL name of the C++ types usable in a function signature.
+template <typename T> struct YAPLType;
+template <> struct YAPLType<int8_t> { static constexpr const char *name = "i8"; };
+template <> struct YAPLType<int16_t> { static constexpr const char *name = "i16"; };
+template <> struct YAPLType<int32_t> { static constexpr const char *name = "int"; };
+template <> struct YAPLType<int64_t> { static constexpr const char *name = "i64"; };
+template <> struct YAPLType<float> { static constexpr const char *name = "f32"; };
+template <> struct YAPLType<double> { static constexpr const char *name = "float"; };
+
+template <typename Signature> struct YAPLSignature;
+
+template <typename Return, typename... Params>
+struct YAPLSignature<Return(Params...)> {
+    // Return type first, then the parameters.
+    static std::vector<std::string> types() {
+        return { YAPLType<Return>::name, YAPLType<Params>::name... };
+    }
+
+    // One input array per parameter, the output array and the element count.
+    using Batch = void(const Params *..., Return *, int64_t);
+};
+
+class YAPLEngine {
+private:
+    std::unique_ptr<IRGenerator> m_Generator;
+    std::map<std::string, void *> m_BatchAddresses;
+
+    explicit YAPLEngine(std::unique_ptr<IRGenerator> generator);
+
+    llvm::Expected<void *> getAddress(const std::string &name, const std::vector<std::string> &types);
+    llvm::Expected<void *> getBatchAddress(const std::string &name, const std::vector<std::string> &types);
+
+public:
+    ~YAPLEngine();
+
+    // Only declarations are accepted, top level expressions are an error.
+    static llvm::Expected<std::unique_ptr<YAPLEngine>> compile(const std::string &source,
+                                                               const Options &options = Options());
+
+    // Fails if the function is not defined or its YAPL signature does not
+    // match Signature.
+    template <typename Signature>
+    llvm::Expected<Signature *> getFunction(const std::string &name) {
+        auto address = getAddress(name, YAPLSignature<Signature>::types());
+
+        if (!address) {
+            return address.takeError();
+        }
+
+        return reinterpret_cast<Signature *>(*address);
+    }
+
+    // Vectorized loop applying the function to columns of count elements:
+    // getBatchFunction<int(int, int)>("f") returns a
+    // void(*)(const int *x, const int *y, int *out, int64_t count).
+    template <typename Signature>
+    llvm::Expected<typename YAPLSignature<Signature>::Batch *> getBatchFunction(const std::string &name) {
+        auto address = getBatchAddress(name, YAPLSignature<Signature>::types());
+
+        if (!address) {
+            return address.takeError();
+        }
+
+        return reinterpret_cast<typename YAPLSignature<Signature>::Batch *>(*address);
+    }
+};
@@ -5,8 +5,10 @@
 #pragma once
 #include <llvm/ADT/APFloat.h>
 #include <llvm/ADT/STLExtras.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
@@ -14,47 +16,174 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "AST/DeclarationAST.hpp"
 #include "Parser/Parser.hpp"
 #include "PassManager/PassManager.hpp"
+#include "Profiler/SourceProfiler.hpp"
 #include "YAPLJIT/YAPLJIT.hpp"
+#include "utils/options.hpp"
 
 class IRGenerator {
 private:
-    llvm::LLVMContext m_Context;
+    Options m_Options;
+
+    // Context of every module generated, which the JIT locks to compile them,
+    // maybe from the worker threads of a parallel loop calling a function first.
+    llvm::orc::ThreadSafeContext m_TSContext;
+    llvm::LLVMContext &m_Context;
     std::unique_ptr<llvm::IRBuilder<>> m_Builder;
     std::unique_ptr<llvm::Module> m_Module;
 
+    std::unique_ptr<llvm::DIBuilder> m_DIBuilder;
+    llvm::DICompileUnit *m_DICompileUnit = nullptr;
+    llvm::DISubprogram *m_DISubprogram = nullptr;
+
+    // Registered to the JIT, must outlive it.
+    std::unique_ptr<SourceProfiler> m_Profiler;
+
+    // Set for the sessions of a server, m_YAPLJIT is then one of its sessions.
+    std::shared_ptr<SharedJIT> m_SharedJIT;
     std::unique_ptr<YAPLJIT> m_YAPLJIT;
 
     std::unique_ptr<PassManager> m_PassManager;
     std::shared_ptr<Lexer> m_Lexer;
     Parser m_Parser;
 
-    std::map<std::string, llvm::Value *> m_NamedValues;
+    std::map<std::string, llvm::AllocaInst *> m_NamedValues;
     std::map<std::string, std::shared_ptr<PrototypeAST>> m_FunctionDefs;
+    // Kept to generate the functions again, inlined in their batch wrapper.
+    std::map<std::string, std::shared_ptr<FunctionDefinitionAST>> m_FunctionBodies;
+    // Number of the current definition of each function, see versionedFunctionName.
+    std::map<std::string, int> m_Versions;
+    // Functions called by each defined function.
+    std::map<std::string, std::set<std::string>> m_Callees;
+    // Functions inlined in the batch wrapper of each function.
+    std::map<std::string, std::set<std::string>> m_BatchInlines;
+    // Batch wrappers to generate again once the current module is added.
+    std::set<std::string> m_StaleBatches;
+
+    // Current symbol of each memoized function, see generateMemoized.
+    std::map<std::string, std::string> m_Memoized;
+
+    // Results of the calls evaluated at compile time, see foldCall.
+    std::map<std::pair<std::string, std::vector<llvm::Constant *>>, llvm::Constant *> m_FoldedCalls;
+    // Functions whose code a folded call of the function being generated ran.
+    std::set<std::string> m_FoldedCallees;
+    // Functions run by the folded calls of each function, which is generated
+    // again when one of them is redefined.
+    std::map<std::string, std::set<std::string>> m_FoldDependencies;
+    // Functions to generate again once the current module is added.
+    std::set<std::string> m_StaleFolds;
+    int m_FoldedCallCount = 0;
+    // Whether the code being generated runs on every call of its function:
+    // outside of conditions and loops, and of the rest of a function past a
+    // conditional return. Calls are only folded there.
+    bool m_AlwaysRuns = false;
+
+    // Type of every global variable, declared in the modules using it.
+    std::map<std::string, std::string> m_Globals;
+    // Number of the last initializer of each global. Apart from m_Versions,
+    // an initializer is called once by its symbol and has no stub.
+    std::map<std::string, int> m_InitializerVersions;
+    // Initializers of the globals defined in the current module, run once it is added.
+    std::vector<std::string> m_PendingInitializers;
+    // Stubs pointed to their implementation once its module is added rather
+    // than on their first call, see YAPLJIT::resolveStub: those of functions
+    // taking vectors, and every stub of a server session. A stub whose
+    // function calls one not defined yet waits for its definition.
+    std::set<std::string> m_EagerStubs;
+
+    // Every module added to the JIT, linked for --emit-bc.
+    std::unique_ptr<llvm::Module> m_ExportModule;
+    // Top level expressions of m_ExportModule, in the order they ran.
+    std::vector<std::string> m_ExportedEntries;
 
 public:
     IRGenerator(const char *argv);
+    IRGenerator(const Options &options);
+    IRGenerator(std::shared_ptr<Lexer> lexer, const Options &options,
+                std::shared_ptr<SharedJIT> sharedJIT = nullptr);
 
     ~IRGenerator() = default;
 
     void generate();
+    std::vector<std::shared_ptr<ExprAST>> parseProgram();
+    std::vector<std::shared_ptr<ExprAST>> loadProgram();
+    void runProgram(std::vector<std::shared_ptr<ExprAST>> program);
+    void generateEntry(std::shared_ptr<ExprAST> expr);
+    void evaluateTopLevel(const std::string &name, llvm::FunctionType *type);
+    llvm::Error compile();
+    llvm::Error generateBatch(const std::string &name);
+
+    llvm::Expected<llvm::JITEvaluatedSymbol> lookup(const std::string &name);
+    // Frees the compiled code once generate() returned, for server sessions.
+    llvm::Error clearJIT();
+    std::shared_ptr<PrototypeAST> getPrototype(const std::string &name) const;
+    std::vector<std::string> getCallers(const std::string &name) const;
 
     llvm::Value *generateTopLevel(std::shared_ptr<ExprAST> parsedExpression);
     llvm::Value *generateBinary(std::shared_ptr<BinaryOpExprAST> parsedBinaryOpExpr);
+    llvm::Value *generateCast(std::shared_ptr<CastExprAST> parsedCast);
+    llvm::Value *generateConditional(std::shared_ptr<ConditionalExprAST> parsedConditional);
     llvm::Value *generateFunctionCall(std::shared_ptr<CallFunctionExprAST> parsedFunctionCall);
+    llvm::Constant *foldCall(const std::string &name, llvm::Function *callee, const std::vector<llvm::Value *> &args);
+    bool isSideEffectFree(const std::string &name, std::set<std::string> &visited);
+    bool callsUndefinedFunction(const std::string &name);
+    llvm::Value *generateMathBuiltin(std::shared_ptr<CallFunctionExprAST> parsedFunctionCall);
+    llvm::Value *generateReduction(std::shared_ptr<CallFunctionExprAST> parsedFunctionCall);
+    llvm::Value *generateVector(std::shared_ptr<VectorExprAST> parsedVector);
+    llvm::Function *generateVectorResult(llvm::Function *function);
+
+    bool generateStatement(std::shared_ptr<ExprAST> statement);
+    void generateLocal(const std::string &name, llvm::Value *value);
+    llvm::Value *getVariable(const std::string &name);
+    llvm::Value *generateCondition(const std::shared_ptr<ExprAST> &condition);
+    bool generateLoop(const std::shared_ptr<ExprAST> &condition,
+                      const std::vector<std::shared_ptr<ExprAST>> &body,
+                      const std::shared_ptr<ExprAST> &step);
+    bool generateParallelFor(const std::shared_ptr<ParallelForExprAST> &loop);
+    bool generateIf(const std::shared_ptr<IfExprAST> &ifExpr);
+    bool generateReturn(const std::shared_ptr<ExprAST> &value);
+    llvm::AllocaInst *createEntryBlockAlloca(llvm::Function *function, const std::string &name, llvm::Type *type);
 
     llvm::Function *generateDeclaration(std::shared_ptr<DeclarationAST> parsedDeclaration);
     llvm::Function *generatePrototype(std::shared_ptr<PrototypeAST> parsedPrototype);
-    llvm::Function *generateFunctionDefinition(std::shared_ptr<FunctionDefinitionAST> parsedFunctionDefinition);
+    bool generateGlobal(std::shared_ptr<DeclarationAST> parsedDeclaration);
+    llvm::Error runInitializers();
+    llvm::Function *generateMemoized(llvm::Function *body, const std::string &name);
+    void clearMemoizedCallers(const std::string &name);
+    llvm::Function *generateFunctionVersion(std::shared_ptr<FunctionDefinitionAST> parsedFunctionDefinition);
+    llvm::Function *generateFunctionDefinition(std::shared_ptr<FunctionDefinitionAST> parsedFunctionDefinition,
+                                               const std::string &symbol);
     llvm::Function *getFunction(const std::string &name);
+    llvm::Type *getLLVMType(const std::string &type);
+    void setFPMode(const PrototypeAST &proto, llvm::Function *function);
 
     std::unique_ptr<llvm::Module> getModule() { return std::move(m_Module); }
 
+    void initializeJIT();
     void reloadModuleAndPassManger();
+    llvm::Error addModuleToJIT();
+
+    llvm::Error benchmark(const std::string &call);
+
+    llvm::Error writeBitcode(const std::string &path);
+    llvm::Error loadBitcode(const std::string &path);
+
+    void createDebugInfo();
+    llvm::DIType *getDebugType(const std::string &type);
+    llvm::DISubprogram *generateDebugSubprogram(const PrototypeAST &proto, llvm::Function *function);
+    void emitLocation(const ExprAST *expr);
+
+    void reportTimings();
+    void runCommand(const std::string &command);
+    void reportMemoization();
 };
 
 
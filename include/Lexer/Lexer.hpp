@@ -16,16 +16,31 @@ class Lexer {
 private:
     FILE* m_File;
     bool m_HasFile;
+
+    // Set when lexing an in-memory source instead of a file or stdin.
+    bool m_HasSource = false;
+    std::string m_Source;
+    size_t m_SourcePosition = 0;
     std::string m_Identifier;
     std::string m_ValueStr;
     int m_CurrentChar = ' ';
     int m_CharCount = 0;
     int m_LineCount = 1;
+    int m_ColumnCount = 0;
+
+    int m_TokenLine = 0;
+    int m_TokenColumn = 0;
+
+    Token lexToken();
 
 public:
     Lexer(const char* path);
     ~Lexer();
 
+    static std::shared_ptr<Lexer> fromSource(std::string source);
+    // Read like stdin, as a REPL, the caller closes file.
+    static std::shared_ptr<Lexer> fromStream(std::FILE *file);
+
     int getChar();
     Token getToken();
 
@@ -36,6 +51,7 @@ public:
     int getCurrentChar() const;
     const int &getCharCount() const;
     const int &getLineCount() const;
+    const int &getColumnCount() const;
 
     const bool hasFile() const;
 };
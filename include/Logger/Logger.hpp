@@ -0,0 +1,112 @@
+#pragma once
+
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdio>
+#include <iostream>
+#include <streambuf>
+
+/*
+ * Levels of the messages printed besides errors: the results of the top
+ * level expressions are Info, the traces of the compilation such as the IR
+ * of every declaration are Debug. Errors are always printed.
+ *
+ * Messages above YAPL_MAX_LOG_LEVEL, set by configuring with
+ * -DYAPL_LOG_LEVEL=error|info|debug, are compiled out. The others are
+ * filtered by the level set at run time, checked before formatting
+ * anything.
+ *
+ * Messages, errors included, go to stderr unless the calling thread
+ * redirected them to a LogOutput, as the sessions of a server do.
+ */
+enum class LogLevel {
+    Error,
+    Info,
+    Debug
+};
+
+#ifndef YAPL_MAX_LOG_LEVEL
+#define YAPL_MAX_LOG_LEVEL 2
+#endif
+
+// Messages written to a FILE, such as the socket of a client, through
+// every kind of stream the compiler prints to.
+class LogOutput {
+private:
+    class StreamBuffer : public std::streambuf {
+    private:
+        std::FILE *m_File;
+    public:
+        explicit StreamBuffer(std::FILE *file) : m_File(file) {}
+
+    protected:
+        int overflow(int character) override {
+            return character == EOF ? 0 : std::fputc(character, m_File);
+        }
+
+        std::streamsize xsputn(const char *characters, std::streamsize count) override {
+            return std::fwrite(characters, 1, count, m_File);
+        }
+
+        // std::flush and std::endl
+        int sync() override { return std::fflush(m_File); }
+    };
+
+    class LLVMStream : public llvm::raw_ostream {
+    private:
+        std::FILE *m_File;
+        uint64_t m_Position = 0;
+
+        void write_impl(const char *characters, size_t count) override {
+            m_Position += std::fwrite(characters, 1, count, m_File);
+        }
+
+        uint64_t current_pos() const override { return m_Position; }
+
+    public:
+        // Unbuffered, the FILE buffers for every stream.
+        explicit LLVMStream(std::FILE *file) : llvm::raw_ostream(true), m_File(file) {}
+    };
+
+    std::FILE *m_File;
+    StreamBuffer m_StreamBuffer;
+    std::ostream m_Stream;
+    LLVMStream m_LLVMStream;
+
+public:
+    explicit LogOutput(std::FILE *file)
+        : m_File(file), m_StreamBuffer(file), m_Stream(&m_StreamBuffer), m_LLVMStream(file)
+    {}
+
+    std::FILE *getFile() { return m_File; }
+    std::ostream &getStream() { return m_Stream; }
+    llvm::raw_ostream &getLLVMStream() { return m_LLVMStream; }
+};
+
+class Logger {
+private:
+    inline static LogLevel s_Level = LogLevel::Debug;
+    inline static thread_local LogOutput *t_Output = nullptr;
+
+public:
+    static constexpr LogLevel getMaxLevel() { return static_cast<LogLevel>(YAPL_MAX_LOG_LEVEL); }
+
+    static LogLevel getLevel() { return s_Level; }
+    static void setLevel(LogLevel level) { s_Level = level; }
+
+    static bool isEnabled(LogLevel level) {
+        return level <= getMaxLevel() && level <= s_Level;
+    }
+
+    // Messages of the calling thread go to output, or to stderr when nullptr.
+    static void setThreadOutput(LogOutput *output) { t_Output = output; }
+
+    static std::FILE *file() { return t_Output ? t_Output->getFile() : stderr; }
+    static std::ostream &stream() { return t_Output ? t_Output->getStream() : std::cerr; }
+    static llvm::raw_ostream &llvmStream() { return t_Output ? t_Output->getLLVMStream() : llvm::errs(); }
+};
+
+// Runs the statement following it only when messages of the level are
+// printed, its operands are not evaluated otherwise:
+//     YAPL_LOG(Debug) function->print(llvm::errs());
+#define YAPL_LOG(LEVEL) if (!Logger::isEnabled(LogLevel::LEVEL)) {} else
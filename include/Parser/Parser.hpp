@@ -25,10 +25,15 @@ private:
     std::mutex m_Mutex;
     std::deque<Token> m_Tokens;
     std::deque<Token> m_ToProcess;
+    bool m_LexerDone = false;
 
     int m_AnonFuncNum = 0;
 
     std::map<std::string, std::string> m_NameType;
+    // Parameter types of the declared functions.
+    std::map<std::string, std::vector<std::string>> m_ParamTypes;
+
+    void startIOThread();
 
 public:
     Parser(std::shared_ptr<Lexer> lexer);
@@ -38,25 +43,42 @@ public:
     Token getNextToken();
     Token waitForToken();
 
-    const int getAnonFuncNum() const { return m_AnonFuncNum; }
-    void incrementAnonFuncNum() { m_AnonFuncNum++; }
-
     void parse();
     std::shared_ptr<ExprAST> parseNext();
     std::shared_ptr<ExprAST> parsePrimaryExpr(const std::string &scope = "");
     std::shared_ptr<ExprAST> parseTopLevelExpr();
     std::shared_ptr<DeclarationAST> parseDeclaration(const std::string &scope = "");
+    std::shared_ptr<DeclarationAST> parseAttributes();
     void parseInclude();
     std::shared_ptr<PrototypeAST> parsePrototype(std::shared_ptr<DeclarationAST> declarationAST);
-    std::shared_ptr<VariableDefinitionAST> parseVariableDefinition(std::shared_ptr<DeclarationAST> declarationAST);
+    std::shared_ptr<PrototypeAST> checkBuiltinPrototype(std::shared_ptr<PrototypeAST> proto);
+    // Types later calls are checked against.
+    void declare(const PrototypeAST &proto);
+    void declareVariable(const std::string &name, const std::string &type);
+    std::shared_ptr<VariableDefinitionAST> parseVariableDefinition(std::shared_ptr<DeclarationAST> declarationAST,
+                                                                   const std::string &scope = "");
     std::shared_ptr<FunctionDefinitionAST> parseDefinition(std::shared_ptr<PrototypeAST> proto);
+    std::shared_ptr<ExprAST> parseStatement(const std::string &scope);
+    std::shared_ptr<ExprAST> parseSimpleStatement(const std::string &scope);
+    bool parseBlock(const std::string &scope, std::vector<std::shared_ptr<ExprAST>> &statements);
+    std::shared_ptr<ExprAST> parseCondition(const std::string &scope);
+    std::shared_ptr<ExprAST> parseFor(const std::string &scope);
+    std::shared_ptr<ExprAST> parseWhile(const std::string &scope);
+    std::shared_ptr<ExprAST> parseParallelFor(const std::string &scope);
+    std::shared_ptr<ExprAST> parseIf(const std::string &scope);
+    std::shared_ptr<ExprAST> parseReturn(const std::string &scope);
     std::shared_ptr<ExprAST> parseIdentifier(const std::string &scope = "");
+    bool parseMathBuiltinArgs(const std::string &name, std::vector<std::shared_ptr<ExprAST>> &args);
     std::shared_ptr<IntExprAST> parseIntExpr();
     std::shared_ptr<FloatExprAST> parseFloatExpr();
     std::shared_ptr<ExprAST> parseParensExpr(const std::string &scope = "");
+    std::shared_ptr<ExprAST> parseVectorExpr(const std::string &scope = "");
+    std::shared_ptr<ExprAST> parseCast(const std::string &scope = "");
+    std::shared_ptr<ExprAST> convertLiteral(std::shared_ptr<ExprAST> expr, const std::string &type);
 
     std::shared_ptr<ExprAST> parseExpression(const std::string &scope = "");
 
+    std::shared_ptr<ExprAST> parseConditional(std::shared_ptr<ExprAST> condition, const std::string &scope = "");
     std::shared_ptr<ExprAST> parseBinaryExpr(int exprPrec, std::shared_ptr<ExprAST> LHS, const std::string &scope = "");
 };
 
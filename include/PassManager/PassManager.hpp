@@ -5,15 +5,21 @@
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Target/TargetMachine.h>
 #include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/GVN.h>
 
 class PassManager {
 private:
-    std::unique_ptr<llvm::Module> m_Module;
+    llvm::Module *m_Module;
+    llvm::TargetMachine *m_TargetMachine;
     std::unique_ptr<llvm::legacy::FunctionPassManager> m_FunctionPassManager;
 public:
-    PassManager(llvm::Module* module);
+    PassManager(llvm::Module* module, llvm::TargetMachine *targetMachine = nullptr);
     void run(llvm::Function &function);
+
+    // Inlines, then loop and SLP vectorizes the whole module using the
+    // target's cost model.
+    void runVectorizer();
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+/*
+ * Sampling profiler for JIT compiled YAPL code.
+ *
+ * As a JIT event listener it reads the DWARF line table of every linked
+ * object, and while running it samples the program counter on SIGPROF.
+ * The report maps the samples back to YAPL file:line.
+ */
+class SourceProfiler : public llvm::JITEventListener {
+private:
+    struct FunctionRange {
+        uint64_t end;
+        std::string name;
+    };
+
+    struct LineEntry {
+        std::string file;
+        unsigned line;
+    };
+
+    mutable std::mutex m_Mutex;
+    std::map<uint64_t, FunctionRange> m_Functions;
+    std::map<uint64_t, LineEntry> m_Lines;
+
+    bool m_Running = false;
+
+public:
+    SourceProfiler() = default;
+    ~SourceProfiler() override;
+
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                            const llvm::RuntimeDyld::LoadedObjectInfo &loadedObject) override;
+
+    bool start(unsigned intervalMicroseconds = 1000);
+    void stop();
+
+    void printReport(std::ostream &stream, size_t maxLines = 20) const;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Runtime of the parallel for loops, called by the JIT compiled code.
+ *
+ * A loop is split in chunks spread over the queues of a pool of worker
+ * threads, one per core. A worker runs the chunks of its own queue, newest
+ * first, then steals the oldest chunks of the other queues. The thread
+ * starting the loop runs chunks too until the whole loop is done, so loops
+ * may nest.
+ */
+
+// Body of a loop outlined by the IR generator, runs the iterations [begin, end).
+using ParallelBody = void (*)(void *context, int64_t begin, int64_t end);
+
+class ParallelRuntime {
+private:
+    struct Chunk {
+        ParallelBody body;
+        void *context;
+        int64_t begin;
+        int64_t end;
+        // Chunks of the loop not yet run.
+        std::atomic<int64_t> *pending;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_Queues;
+    std::vector<std::thread> m_Workers;
+
+    // Idle workers sleep until chunks are queued.
+    std::mutex m_SleepMutex;
+    std::condition_variable m_Wakeup;
+    std::atomic<int64_t> m_Queued{0};
+    bool m_Stop = false;
+
+    explicit ParallelRuntime(unsigned workers);
+
+    void work(unsigned index);
+    bool runOne(int queue);
+
+public:
+    ~ParallelRuntime();
+
+    // Started on first use, YAPL_NUM_THREADS overrides the number of cores.
+    static ParallelRuntime &get();
+
+    unsigned getNumThreads() const { return m_Queues.size(); }
+
+    void parallelFor(int64_t begin, int64_t end, ParallelBody body, void *context);
+};
+
+// Symbol called by the generated code, defined in the main JITDylib.
+extern "C" void yapl_parallel_for(int64_t begin, int64_t end, ParallelBody body, void *context);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <llvm/Support/Error.h>
+
+#include <memory>
+#include <string>
+
+#include "YAPLJIT/YAPLJIT.hpp"
+#include "utils/options.hpp"
+
+/*
+ * Serves REPL sessions on a Unix domain socket, for short-lived jobs that
+ * would otherwise pay the startup of a yapl process each.
+ *
+ * A client connection is a session: the client writes source, the server
+ * writes back what the REPL prints, prompts, results and errors. Each
+ * session runs on its own thread with its own front end and JITDylib,
+ * sessions do not see each other's functions nor globals. They share one
+ * concurrent SharedJIT, its execution session and layers, and compile
+ * their modules in parallel.
+ */
+class YAPLServer {
+private:
+    Options m_Options;
+    std::string m_SocketPath;
+    std::shared_ptr<SharedJIT> m_JIT;
+    int m_Socket = -1;
+
+    void runSession(int connection);
+
+public:
+    YAPLServer(const Options &options, std::string socketPath);
+    ~YAPLServer();
+
+    YAPLServer(const YAPLServer &) = delete;
+    YAPLServer &operator=(const YAPLServer &) = delete;
+
+    // Creates the JIT and listens on the socket. A socket no server listens
+    // on is replaced, any other existing file is an error.
+    llvm::Error listen();
+    // Accepts clients until the socket fails, each on a new thread.
+    void serve();
+
+    // Sends inputPath, or stdin when empty, to the server listening on
+    // socketPath and copies its output to stderr. Returns the exit status.
+    static int runClient(const std::string &socketPath, const std::string &inputPath);
+};
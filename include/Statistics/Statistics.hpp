@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+/*
+ * Named counters updated by the compiler, in the spirit of LLVM's
+ * STATISTIC(). Each Statistic registers itself on construction and is
+ * listed by Statistics::print().
+ *
+ * Configure with -DYAPL_ENABLE_STATISTICS=OFF to compile every counter
+ * down to nothing.
+ */
+
+#ifdef YAPL_ENABLE_STATISTICS
+
+class Statistic {
+private:
+    const char *m_Group;
+    const char *m_Name;
+    const char *m_Description;
+    std::atomic<uint64_t> m_Value{0};
+
+public:
+    Statistic(const char *group, const char *name, const char *description);
+
+    Statistic(const Statistic &) = delete;
+    Statistic &operator=(const Statistic &) = delete;
+
+    Statistic &operator++() { m_Value.fetch_add(1, std::memory_order_relaxed); return *this; }
+    Statistic &operator+=(uint64_t value) { m_Value.fetch_add(value, std::memory_order_relaxed); return *this; }
+
+    void set(uint64_t value) { m_Value.store(value, std::memory_order_relaxed); }
+
+    void updateMax(uint64_t value) {
+        uint64_t current = m_Value.load(std::memory_order_relaxed);
+        while (value > current &&
+                !m_Value.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t getValue() const { return m_Value.load(std::memory_order_relaxed); }
+    const char *getGroup() const { return m_Group; }
+    const char *getName() const { return m_Name; }
+    const char *getDescription() const { return m_Description; }
+};
+
+#else
+
+class Statistic {
+public:
+    constexpr Statistic(const char *, const char *, const char *) {}
+
+    Statistic &operator++() { return *this; }
+    Statistic &operator+=(uint64_t) { return *this; }
+
+    void set(uint64_t) {}
+    void updateMax(uint64_t) {}
+
+    uint64_t getValue() const { return 0; }
+};
+
+#endif
+
+#define YAPL_STATISTIC(VARNAME, GROUP, DESC) static Statistic VARNAME{GROUP, #VARNAME, DESC}
+
+class Statistics {
+public:
+    static constexpr bool isEnabled() {
+#ifdef YAPL_ENABLE_STATISTICS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void print(std::ostream &stream);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class Phase {
+    Lex = 0,
+    Parse,
+    IRGen,
+    Optimize,
+    JIT,
+    Execute,
+    Count
+};
+
+/*
+ * Collects wall clock timings of every compilation phase, per top level
+ * declaration and in aggregate. Everything is a no-op until enable() is
+ * called, so the timers can stay in the hot paths.
+ *
+ * Nested scopes are exclusive: the time spent in an inner scope is not
+ * accounted to the enclosing one.
+ */
+class TimeReport {
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t s_PhaseCount = static_cast<size_t>(Phase::Count);
+
+    struct Entry {
+        std::string name;
+        std::array<uint64_t, s_PhaseCount> nanoseconds{};
+    };
+
+    bool m_Enabled = false;
+
+    // The lexer runs on the parser's IO thread, it is accumulated separately.
+    std::atomic<uint64_t> m_LexNanoseconds{0};
+    std::atomic<uint64_t> m_LexCalls{0};
+
+    mutable std::mutex m_Mutex;
+    Entry m_Current;
+    std::vector<Entry> m_Entries;
+
+    TimeReport() = default;
+
+    void addTime(Phase phase, uint64_t nanoseconds);
+
+public:
+    class Scope {
+    private:
+        Phase m_Phase;
+        bool m_Active;
+        Clock::time_point m_Start;
+        Scope *m_Parent;
+
+        void flush();
+    public:
+        Scope(Phase phase);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    static TimeReport &get();
+
+    void enable() { m_Enabled = true; }
+    bool isEnabled() const { return m_Enabled; }
+
+    void endEntry(const std::string &name);
+
+    void print(std::ostream &stream) const;
+    bool writeJSON(const std::string &path) const;
+
+    static const char *phaseToString(Phase phase);
+};
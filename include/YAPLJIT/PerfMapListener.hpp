@@ -0,0 +1,26 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+#include <cstdio>
+#include <mutex>
+
+/*
+ * Writes the symbols of every object linked by the JIT to
+ * /tmp/perf-<pid>.map, the format `perf report` uses to name code that
+ * is not backed by a file.
+ */
+class PerfMapListener : public llvm::JITEventListener {
+private:
+    std::FILE *m_File;
+    std::mutex m_Mutex;
+
+public:
+    PerfMapListener();
+    ~PerfMapListener() override;
+
+    bool isValid() const { return m_File != nullptr; }
+
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                            const llvm::RuntimeDyld::LoadedObjectInfo &loadedObject) override;
+};
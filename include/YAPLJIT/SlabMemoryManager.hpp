@@ -0,0 +1,47 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/JITLink/JITLinkMemoryManager.h>
+#include <llvm/Support/Memory.h>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/*
+ * JITLink memory manager carving every allocation out of large slabs
+ * shared by all the linked objects, instead of mapping fresh pages for
+ * each of them.
+ *
+ * All the segments of an allocation come from the same slab, so that the
+ * code of an object stays within reach of PC-relative relocations to its
+ * data. Pages are taken from the bottom of the slab: the protection is
+ * applied per page when the allocation is finalized. Read/write segments
+ * never change protection, they are packed at byte granularity from the
+ * top of the slab.
+ *
+ * Memory is only given back when the manager is destroyed: the JIT never
+ * removes code.
+ */
+class SlabMemoryManager : public llvm::jitlink::JITLinkMemoryManager {
+private:
+    // Free memory of the current slab, between the last pages and the last data.
+    struct Slab {
+        char *pages = nullptr;
+        char *data = nullptr;
+    };
+
+    size_t m_SlabSize;
+    size_t m_PageSize;
+
+    std::mutex m_Mutex;
+    std::vector<llvm::sys::MemoryBlock> m_Slabs;
+    Slab m_Current;
+
+    llvm::Error reserve(size_t pageBytes, size_t dataBytes, size_t dataAlignment);
+
+public:
+    SlabMemoryManager(size_t slabSize = 64 * 1024 * 1024);
+    ~SlabMemoryManager() override;
+
+    llvm::Expected<std::unique_ptr<Allocation>> allocate(const SegmentsRequestMap &request) override;
+};
@@ -1,85 +1,552 @@
 #pragma once
 
 #include <llvm/ADT/StringRef.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
 #include <llvm/ExecutionEngine/JITSymbol.h>
 #include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/Core.h>
 #include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
 #include <llvm/ExecutionEngine/Orc/IRCompileLayer.h>
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
 #include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LazyReexports.h>
+#include <llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h>
 #include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
-class YAPLJIT {
+#include "Logger/Logger.hpp"
+#include "Runtime/ParallelRuntime.hpp"
+#include "Statistics/Statistics.hpp"
+#include "TimeReport/TimeReport.hpp"
+#include "YAPLJIT/PerfMapListener.hpp"
+#include "YAPLJIT/SlabMemoryManager.hpp"
+#include "utils/options.hpp"
+
+inline Statistic NumJITModules{"jit", "NumJITModules", "Modules added to the JIT"};
+inline Statistic NumJITObjects{"jit", "NumJITObjects", "Objects linked by the JIT"};
+inline Statistic NumJITCodeBytes{"jit", "NumJITCodeBytes", "Bytes of JIT code memory"};
+inline Statistic NumJITDataBytes{"jit", "NumJITDataBytes", "Bytes of JIT data memory"};
+inline Statistic NumJITStubs{"jit", "NumJITStubs", "Indirection stubs created"};
+inline Statistic NumJITStubUpdates{"jit", "NumJITStubUpdates", "Indirection stubs pointed to a redefinition"};
+
+// SectionMemoryManager accounting for the memory it hands out.
+class CountingMemoryManager : public llvm::SectionMemoryManager {
+public:
+    uint8_t *allocateCodeSection(uintptr_t size, unsigned alignment, unsigned sectionID,
+                                 llvm::StringRef sectionName) override {
+        NumJITCodeBytes += size;
+        return llvm::SectionMemoryManager::allocateCodeSection(size, alignment, sectionID, sectionName);
+    }
+
+    uint8_t *allocateDataSection(uintptr_t size, unsigned alignment, unsigned sectionID,
+                                 llvm::StringRef sectionName, bool isReadOnly) override {
+        NumJITDataBytes += size;
+        return llvm::SectionMemoryManager::allocateDataSection(size, alignment, sectionID, sectionName, isReadOnly);
+    }
+};
+
+// Functions are compiled on their first call, possibly by several threads at
+// once from a parallel loop: the TargetMachine must only be used by one.
+class SerialCompiler : public llvm::orc::SimpleCompiler {
+private:
+    std::mutex m_Mutex;
+public:
+    using llvm::orc::SimpleCompiler::SimpleCompiler;
+
+    llvm::Expected<CompileResult> operator()(llvm::Module &module) override {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return llvm::orc::SimpleCompiler::operator()(module);
+    }
+};
+
+/*
+ * Compiles the modules of concurrent sessions in parallel: each compilation
+ * takes an idle TargetMachine, or creates one, so there are as many as
+ * modules ever compiled at once.
+ */
+class PooledCompiler : public llvm::orc::IRCompileLayer::IRCompiler {
+private:
+    llvm::orc::JITTargetMachineBuilder m_Builder;
+    std::mutex m_Mutex;
+    std::vector<std::unique_ptr<llvm::TargetMachine>> m_Idle;
+public:
+    explicit PooledCompiler(llvm::orc::JITTargetMachineBuilder builder)
+        : IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(builder.getOptions())),
+        m_Builder(std::move(builder))
+    {}
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module &module) override {
+        std::unique_ptr<llvm::TargetMachine> targetMachine;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (!m_Idle.empty()) {
+                targetMachine = std::move(m_Idle.back());
+                m_Idle.pop_back();
+            }
+        }
+
+        if (!targetMachine) {
+            auto created = m_Builder.createTargetMachine();
+
+            if (!created) {
+                return created.takeError();
+            }
+
+            targetMachine = std::move(*created);
+        }
+
+        auto result = llvm::orc::SimpleCompiler(*targetMachine)(module);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Idle.push_back(std::move(targetMachine));
+
+        return result;
+    }
+};
+
+/*
+ * Accounts the compilation and linking of every module to the JIT phase of
+ * the time report. A function compiled on its first call is materialized
+ * while the calling code runs, inside the Execute phase.
+ */
+class TimedIRLayer : public llvm::orc::IRLayer {
+private:
+    llvm::orc::IRLayer &m_BaseLayer;
+public:
+    TimedIRLayer(llvm::orc::ExecutionSession &executionSession, llvm::orc::IRLayer &baseLayer)
+        : IRLayer(executionSession, baseLayer.getManglingOptions()), m_BaseLayer(baseLayer)
+    {}
+
+    void emit(std::unique_ptr<llvm::orc::MaterializationResponsibility> responsibility,
+              llvm::orc::ThreadSafeModule module) override {
+        TimeReport::Scope timer(Phase::JIT);
+        m_BaseLayer.emit(std::move(responsibility), std::move(module));
+    }
+};
+
+/*
+ * The part of the JIT shared by its sessions: the execution session and the
+ * layers compiling and linking the modules. Each YAPLJIT adds its modules to
+ * its own JITDylib, created here.
+ *
+ * A concurrent JIT, shared by the sessions of a server, compiles modules
+ * with a PooledCompiler. Otherwise a single TargetMachine compiles them one
+ * at a time and gives the optimizer its cost model.
+ */
+class SharedJIT {
 private:
     llvm::orc::ExecutionSession m_ExecutionSession;
-    llvm::orc::RTDyldObjectLinkingLayer m_ObjectLayer;
+    // Must outlive the object layer they are registered to.
+    std::unique_ptr<PerfMapListener> m_PerfMapListener;
+    std::unique_ptr<SlabMemoryManager> m_SlabMemoryManager;
+
+    std::unique_ptr<llvm::orc::ObjectLayer> m_ObjectLayer;
+    // m_ObjectLayer when linking with RuntimeDyld, nullptr with JITLink.
+    llvm::orc::RTDyldObjectLinkingLayer *m_RTDyldLayer;
+    llvm::orc::JITTargetMachineBuilder m_TargetMachineBuilder;
+    std::unique_ptr<llvm::TargetMachine> m_TargetMachine;
     llvm::orc::IRCompileLayer m_CompileLayer;
+    TimedIRLayer m_TimedLayer;
 
     llvm::DataLayout m_DataLayout;
     llvm::orc::MangleAndInterner m_Mangle;
-    llvm::orc::ThreadSafeContext m_TSContext;
 
-    llvm::orc::JITDylib &m_MainJITDylib;
+    bool m_Concurrent;
 
-public:
-    YAPLJIT(llvm::orc::JITTargetMachineBuilder targetMachineBuilder, llvm::DataLayout dataLayout)
-        : m_ObjectLayer(
+    std::mutex m_JITDylibsMutex;
+    unsigned m_NumJITDylibs = 0;
+
+    // Called in place of a function whose compilation failed on its first
+    // call, with its arguments.
+    static void reportLazyCompileFailure() {
+        fprintf(stderr, "Failed to compile a function on its first call\n");
+        abort();
+    }
+
+    // The sessions of a concurrent JIT compile their functions when defining
+    // them, see YAPLJIT::resolveStub, but those calling a function defined
+    // later, which may never be. The failure is printed by the calling thread,
+    // to its session unless it is a worker of a parallel loop, the other
+    // sessions keep running and the call returns 0.
+    static uint64_t reportSessionLazyCompileFailure() {
+        Logger::stream() << "Called a function which failed to compile, its result is undefined" << std::endl;
+        return 0;
+    }
+
+    std::unique_ptr<llvm::orc::ObjectLayer> createObjectLayer(JITLinker linker) {
+        if (linker == JITLinker::JITLink) {
+            m_SlabMemoryManager = std::make_unique<SlabMemoryManager>();
+            return std::make_unique<llvm::orc::ObjectLinkingLayer>(m_ExecutionSession, *m_SlabMemoryManager);
+        }
+
+        return std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
                 m_ExecutionSession,
                 []() {
-                    return std::make_unique<llvm::SectionMemoryManager>();
+                    // Called once for every object the layer links.
+                    ++NumJITObjects;
+                    return std::make_unique<CountingMemoryManager>();
                 }
-            ),
-        m_CompileLayer(
-                m_ExecutionSession,
-                m_ObjectLayer,
-                std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(targetMachineBuilder))
-            ),
+            );
+    }
+
+    std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler> createCompiler(bool concurrent) {
+        if (concurrent) {
+            return std::make_unique<PooledCompiler>(m_TargetMachineBuilder);
+        }
+
+        // Modules are compiled on the thread looking them up, one at a time,
+        // so a single TargetMachine is enough. ConcurrentIRCompiler would
+        // create a new one for every module.
+        return std::make_unique<SerialCompiler>(*m_TargetMachine);
+    }
+
+public:
+    SharedJIT(llvm::orc::JITTargetMachineBuilder targetMachineBuilder,
+              std::unique_ptr<llvm::TargetMachine> targetMachine, llvm::DataLayout dataLayout,
+              JITLinker linker, bool concurrent)
+        : m_ObjectLayer(createObjectLayer(linker)),
+        m_RTDyldLayer(linker == JITLinker::RTDyld ?
+                static_cast<llvm::orc::RTDyldObjectLinkingLayer *>(m_ObjectLayer.get()) :
+                nullptr),
+        m_TargetMachineBuilder(std::move(targetMachineBuilder)),
+        m_TargetMachine(std::move(targetMachine)),
+        m_CompileLayer(m_ExecutionSession, *m_ObjectLayer, createCompiler(concurrent)),
+        m_TimedLayer(m_ExecutionSession, m_CompileLayer),
         m_DataLayout(std::move(dataLayout)),
         m_Mangle(m_ExecutionSession, this->m_DataLayout),
-        m_TSContext(std::make_unique<llvm::LLVMContext>()),
-        m_MainJITDylib(m_ExecutionSession.createBareJITDylib("<main>"))
+        m_Concurrent(concurrent)
+        {}
+
+    static void initializeNativeTarget() {
+        static std::once_flag initialized;
+
+        std::call_once(initialized, []() {
+            llvm::InitializeNativeTarget();
+            llvm::InitializeNativeTargetAsmPrinter();
+            llvm::InitializeNativeTargetAsmParser();
+        });
+    }
+
+    static llvm::Expected<std::shared_ptr<SharedJIT>> Create(JITLinker linker = JITLinker::RTDyld,
+                                                             bool concurrent = false) {
+        initializeNativeTarget();
+
+        auto targetMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+
+        if (!targetMachineBuilder) {
+            return targetMachineBuilder.takeError();
+        }
+
+        // The host is detected once, the same TargetMachine gives the data
+        // layout and compiles every module.
+        auto targetMachine = targetMachineBuilder->createTargetMachine();
+
+        if (!targetMachine) {
+            return targetMachine.takeError();
+        }
+
+        auto dataLayout = (*targetMachine)->createDataLayout();
+
+        return std::make_shared<SharedJIT>(std::move(*targetMachineBuilder), std::move(*targetMachine),
+                                           std::move(dataLayout), linker, concurrent);
+    }
+
+    bool isConcurrent() const { return m_Concurrent; }
+
+    // For the optimizer of a session of a concurrent JIT.
+    llvm::Expected<std::unique_ptr<llvm::TargetMachine>> createTargetMachine() {
+        return m_TargetMachineBuilder.createTargetMachine();
+    }
+
+    // The runtime functions called by the generated code are part of yapl,
+    // they are defined in every JITDylib rather than looked up in the
+    // process, where they are not exported.
+    llvm::Expected<llvm::orc::JITDylib &> createJITDylib() {
+        std::string name;
         {
-            m_MainJITDylib.addGenerator(
-                    llvm::cantFail(
-                        llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
-                                m_DataLayout.getGlobalPrefix()
-                            )
-                        )
-                    );
+            std::lock_guard<std::mutex> lock(m_JITDylibsMutex);
+            name = m_NumJITDylibs++ == 0 ? "<main>" : "<session " + std::to_string(m_NumJITDylibs - 1) + ">";
         }
 
-    static llvm::Expected<std::unique_ptr<YAPLJIT>> Create() {
-        auto JITTargetMachine = llvm::orc::JITTargetMachineBuilder::detectHost();
+        auto &jitDylib = m_ExecutionSession.createBareJITDylib(name);
+        auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                m_DataLayout.getGlobalPrefix());
 
-        if (!JITTargetMachine) {
-            return JITTargetMachine.takeError();
+        if (!generator) {
+            return generator.takeError();
         }
 
-        auto dataLayout = JITTargetMachine->getDefaultDataLayoutForTarget();
+        jitDylib.addGenerator(std::move(*generator));
 
-        if (!dataLayout) {
-            return dataLayout.takeError();
+        auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+
+        if (auto err = jitDylib.define(llvm::orc::absoluteSymbols({
+                { m_Mangle("yapl_parallel_for"),
+                  llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&yapl_parallel_for), flags) }
+            }))) {
+            return err;
         }
 
-        return std::make_unique<YAPLJIT>(std::move(*JITTargetMachine), std::move(*dataLayout));
+        return jitDylib;
+    }
+
+    // The trampolines compiling functions on their first call. A trampoline is
+    // never given back to its manager: each session has its own, freed with it.
+    llvm::Expected<std::unique_ptr<llvm::orc::LazyCallThroughManager>> createLazyCallThrough() {
+        return llvm::orc::createLocalLazyCallThroughManager(m_TargetMachine->getTargetTriple(), m_ExecutionSession,
+                m_Concurrent ? llvm::pointerToJITTargetAddress(&reportSessionLazyCompileFailure) :
+                        llvm::pointerToJITTargetAddress(&reportLazyCompileFailure));
     }
 
+    llvm::orc::ExecutionSession &getExecutionSession() { return m_ExecutionSession; }
+    llvm::orc::IRLayer &getCompileLayer() { return m_TimedLayer; }
     const llvm::DataLayout &getDataLayout() const { return m_DataLayout; }
+    llvm::TargetMachine &getTargetMachine() { return *m_TargetMachine; }
+
+    llvm::orc::SymbolStringPtr mangle(const std::string &name) { return m_Mangle(name); }
 
-    llvm::LLVMContext &getContext() { return *m_TSContext.getContext(); }
+    // JIT event listeners are only supported by the RuntimeDyld layer,
+    // the following return false when linking with JITLink.
 
-    llvm::Error addModule(std::unique_ptr<llvm::Module> module) {
-        return m_CompileLayer.add(m_MainJITDylib,
-                llvm::orc::ThreadSafeModule(std::move(module), m_TSContext));
+    // Write /tmp/perf-<pid>.map for `perf report`.
+    bool enablePerfMap() {
+        if (!m_RTDyldLayer) {
+            return false;
+        }
+
+        m_PerfMapListener = std::make_unique<PerfMapListener>();
+
+        if (m_PerfMapListener->isValid()) {
+            m_RTDyldLayer->registerJITEventListener(*m_PerfMapListener);
+        }
+
+        return true;
+    }
+
+    // Write a jitdump file for `perf inject --jit`, only available when
+    // LLVM was built with LLVM_USE_PERF.
+    bool enablePerfJitDump() {
+        auto *listener = llvm::JITEventListener::createPerfJITEventListener();
+
+        if (!m_RTDyldLayer || !listener) {
+            return false;
+        }
+
+        m_RTDyldLayer->registerJITEventListener(*listener);
+        return true;
+    }
+
+    bool registerJITEventListener(llvm::JITEventListener &listener) {
+        if (!m_RTDyldLayer) {
+            return false;
+        }
+
+        m_RTDyldLayer->registerJITEventListener(listener);
+        return true;
+    }
+
+    // Register every object, debug sections included, to GDB's JIT interface.
+    bool enableGDBRegistration() {
+        if (!m_RTDyldLayer) {
+            return false;
+        }
+
+        m_RTDyldLayer->setProcessAllSections(true);
+        m_RTDyldLayer->registerJITEventListener(*llvm::JITEventListener::createGDBRegistrationListener());
+        return true;
+    }
+};
+
+/*
+ * JIT of one front end: its modules and stubs live in its own JITDylib of
+ * a SharedJIT, whose other JITDylibs it does not see. A session of a
+ * concurrent JIT has its own TargetMachine for the optimizer.
+ */
+class YAPLJIT {
+private:
+    std::shared_ptr<SharedJIT> m_Shared;
+    llvm::orc::JITDylib &m_JITDylib;
+    // Set for the sessions of a concurrent JIT, else the shared one is used.
+    std::unique_ptr<llvm::TargetMachine> m_TargetMachine;
+    std::unique_ptr<llvm::orc::LazyCallThroughManager> m_LazyCallThrough;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> m_StubsManager;
+    // Implementation each stub currently points to, or compiles on its next call.
+    std::map<std::string, std::string> m_StubTargets;
+    std::mutex m_StubsMutex;
+
+public:
+    YAPLJIT(std::shared_ptr<SharedJIT> shared, llvm::orc::JITDylib &jitDylib,
+            std::unique_ptr<llvm::orc::LazyCallThroughManager> lazyCallThrough,
+            std::unique_ptr<llvm::TargetMachine> targetMachine = nullptr)
+        : m_Shared(std::move(shared)),
+        m_JITDylib(jitDylib),
+        m_TargetMachine(std::move(targetMachine)),
+        m_LazyCallThrough(std::move(lazyCallThrough)),
+        m_StubsManager(llvm::orc::createLocalIndirectStubsManagerBuilder(
+                m_Shared->getTargetMachine().getTargetTriple())())
+        {}
+
+    static llvm::Expected<std::unique_ptr<YAPLJIT>> Create(JITLinker linker = JITLinker::RTDyld) {
+        auto shared = SharedJIT::Create(linker);
+
+        if (!shared) {
+            return shared.takeError();
+        }
+
+        return CreateSession(std::move(*shared));
+    }
+
+    // A new session of shared, with its own JITDylib.
+    static llvm::Expected<std::unique_ptr<YAPLJIT>> CreateSession(std::shared_ptr<SharedJIT> shared) {
+        std::unique_ptr<llvm::TargetMachine> targetMachine;
+
+        if (shared->isConcurrent()) {
+            auto created = shared->createTargetMachine();
+
+            if (!created) {
+                return created.takeError();
+            }
+
+            targetMachine = std::move(*created);
+        }
+
+        auto lazyCallThrough = shared->createLazyCallThrough();
+
+        if (!lazyCallThrough) {
+            return lazyCallThrough.takeError();
+        }
+
+        auto jitDylib = shared->createJITDylib();
+
+        if (!jitDylib) {
+            return jitDylib.takeError();
+        }
+
+        return std::make_unique<YAPLJIT>(std::move(shared), *jitDylib, std::move(*lazyCallThrough),
+                                         std::move(targetMachine));
+    }
+
+    bool isConcurrent() const { return m_Shared->isConcurrent(); }
+    const llvm::DataLayout &getDataLayout() const { return m_Shared->getDataLayout(); }
+    llvm::TargetMachine &getTargetMachine() {
+        return m_TargetMachine ? *m_TargetMachine : m_Shared->getTargetMachine();
+    }
+
+    bool enablePerfMap() { return m_Shared->enablePerfMap(); }
+    bool enablePerfJitDump() { return m_Shared->enablePerfJitDump(); }
+    bool registerJITEventListener(llvm::JITEventListener &listener) {
+        return m_Shared->registerJITEventListener(listener);
+    }
+    bool enableGDBRegistration() { return m_Shared->enableGDBRegistration(); }
+
+    // The module is compiled by the first lookup of one of its symbols, on the
+    // thread looking it up, which locks its context: other modules are only
+    // generated in that context while no code of the JITDylib runs.
+    llvm::Error addModule(llvm::orc::ThreadSafeModule module) {
+        ++NumJITModules;
+        return m_Shared->getCompileLayer().add(m_JITDylib, std::move(module));
     }
 
     llvm::Expected<llvm::JITEvaluatedSymbol> lookup(const std::string &name) {
-        return m_ExecutionSession.lookup({&m_MainJITDylib}, m_Mangle(name));
+        return m_Shared->getExecutionSession().lookup({&m_JITDylib}, m_Shared->mangle(name));
     }
 
+    // Removes every symbol of the JITDylib and frees the code and data of its
+    // modules, through the resource trackers of LLVM 12. Nothing may call that
+    // code nor look a symbol up afterwards. The trampolines and stubs are freed
+    // with the YAPLJIT, the JITDylib itself stays in the execution session.
+    llvm::Error clear() {
+        return m_JITDylib.clear();
+    }
+
+    /*
+     * Defines name as an indirection stub: a jump through a pointer, first to
+     * a trampoline compiling implementation on the first call, then to the
+     * compiled implementation. Defining the stub again points it to the new
+     * implementation, code already compiled calling name follows without
+     * being recompiled. Calls running in the previous implementation finish
+     * in it, its code is only freed by clear().
+     */
+    llvm::Error defineStub(const std::string &name, const std::string &implementation) {
+        std::lock_guard<std::mutex> lock(m_StubsMutex);
+
+        auto trampoline = m_LazyCallThrough->getCallThroughTrampoline(
+                m_JITDylib, m_Shared->mangle(implementation),
+                [this, name, implementation](llvm::JITTargetAddress address) -> llvm::Error {
+                    std::lock_guard<std::mutex> lock(m_StubsMutex);
+
+                    // The previous implementation may finish compiling after a redefinition.
+                    if (m_StubTargets[name] != implementation) {
+                        return llvm::Error::success();
+                    }
+
+                    return m_StubsManager->updatePointer(name, address);
+                });
+
+        if (!trampoline) {
+            return trampoline.takeError();
+        }
+
+        bool isRedefinition = m_StubTargets.count(name) != 0;
+        m_StubTargets[name] = implementation;
+
+        if (isRedefinition) {
+            ++NumJITStubUpdates;
+            return m_StubsManager->updatePointer(name, *trampoline);
+        }
+
+        auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+
+        if (auto err = m_StubsManager->createStub(name, *trampoline, flags)) {
+            return err;
+        }
+
+        ++NumJITStubs;
+
+        return m_JITDylib.define(llvm::orc::absoluteSymbols({
+                { m_Shared->mangle(name), m_StubsManager->findStub(name, false) }
+            }));
+    }
+
+    // Compiles the implementation of a stub defined by defineStub, once its
+    // module is added, and points the stub to it: its calls no longer go
+    // through the trampoline, which does not preserve vector registers in full,
+    // and a compilation error is returned here rather than on the first call.
+    llvm::Error resolveStub(const std::string &name) {
+        std::string implementation;
+        {
+            std::lock_guard<std::mutex> lock(m_StubsMutex);
+            implementation = m_StubTargets[name];
+        }
+
+        // Not under the lock: a thread compiling the same module through the
+        // trampoline takes it once done, this lookup waits for that thread.
+        auto address = lookup(implementation);
+
+        if (!address) {
+            return address.takeError();
+        }
+
+        std::lock_guard<std::mutex> lock(m_StubsMutex);
+
+        if (m_StubTargets[name] != implementation) {
+            return llvm::Error::success();
+        }
+
+        return m_StubsManager->updatePointer(name, address->getAddress());
+    }
 };
@@ -4,18 +4,40 @@
 
 #pragma once
 
+#include <climits>
 #include <string>
+#include <vector>
 
 #include "utils/token.hpp"
 #include "utils/type.h"
 
+// i32 and f64 are spelled int and float, char is i8.
+static std::string canonicalTypeName(const std::string &name) {
+    if (name == "i32")
+        return "int";
+    if (name == "f64")
+        return "float";
+    if (name == "char")
+        return "i8";
+
+    return name;
+}
+
 static type strToType(const std::string &str) {
-    if (str == "int")
+    std::string name = canonicalTypeName(str);
+
+    if (name == "int")
         return type_int;
-    if (str == "float")
+    if (name == "float")
         return type_float;
-    if (str == "char")
+    if (name == "i8")
         return type_char;
+    if (name == "i16")
+        return type_i16;
+    if (name == "i64")
+        return type_i64;
+    if (name == "f32")
+        return type_f32;
 
     return type_void;
 }
@@ -27,19 +49,155 @@ static std::string typeToString(type t_Type) {
         case type_float:
             return "float";
         case type_char:
-            return "char";
+            return "i8";
+        case type_i16:
+            return "i16";
+        case type_i64:
+            return "i64";
+        case type_f32:
+            return "f32";
         case type_void:
             return "void";
     }
 }
 
-static int getTokenPrecedence(int tok) {
-    if (!isascii(tok)) {
-        return -1;
+static bool isTypeName(const std::string &name) {
+    return strToType(name) != type_void;
+}
+
+// Number of elements of a fixed size vector type such as "float[8]", 0 for scalars.
+static unsigned vectorWidth(const std::string &type) {
+    auto open = type.find('[');
+
+    return open == std::string::npos ? 0 : std::stoul(type.substr(open + 1));
+}
+
+// Element type of a vector type, the type itself for scalars.
+static std::string elementType(const std::string &type) {
+    return type.substr(0, type.find('['));
+}
+
+static std::string vectorType(const std::string &element, unsigned width) {
+    return element + "[" + std::to_string(width) + "]";
+}
+
+// Integer scalar or vector type, whatever its width.
+static bool isIntegerType(const std::string &type) {
+    switch (strToType(elementType(type))) {
+        case type_int:
+        case type_char:
+        case type_i16:
+        case type_i64:
+            return true;
+        default:
+            return false;
     }
+}
+
+static bool isFloatType(const std::string &type) {
+    auto elementKind = strToType(elementType(type));
+
+    return elementKind == type_float || elementKind == type_f32;
+}
+
+// Vector reductions callable as functions, such as sum(v).
+static bool isReduction(const std::string &name) {
+    return name == "sum" || name == "product" || name == "min" || name == "max";
+}
+
+// Number of arguments of the math functions lowered to LLVM intrinsics, 0 for
+// other names. min and max of a single vector are reductions.
+static size_t mathBuiltinArity(const std::string &name) {
+    if (name == "sqrt" || name == "exp" || name == "log" || name == "fabs")
+        return 1;
+    if (name == "pow" || name == "min" || name == "max")
+        return 2;
+    if (name == "fma")
+        return 3;
+
+    return 0;
+}
+
+static bool isMathBuiltin(const std::string &name) {
+    return mathBuiltinArity(name) != 0;
+}
 
+// Whether a prototype of a builtin keeps the signature calls are lowered
+// with: a vector and its element type for reductions, otherwise arguments
+// and result of one type, floating point except for min and max.
+static bool isBuiltinSignature(const std::string &name, const std::string &returnType,
+                               const std::vector<std::string> &paramTypes) {
+    if (isReduction(name) && paramTypes.size() == 1) {
+        return vectorWidth(paramTypes[0]) != 0 && elementType(paramTypes[0]) == returnType;
+    }
+
+    if (paramTypes.size() != mathBuiltinArity(name)) {
+        return false;
+    }
+
+    for (const auto &type : paramTypes) {
+        if (type != returnType) {
+            return false;
+        }
+    }
+
+    return name == "min" || name == "max" || isFloatType(returnType);
+}
+
+// Keywords annotating a function declaration, before its type.
+static bool isFunctionAttribute(const std::string &name) {
+    return name == "fastmath" || name == "fpcontract" || name == "strictmath" || name == "pure";
+}
+
+// Symbol of the function wrapping the n-th top level expression.
+static std::string anonFunctionName(int anonFuncNum) {
+    return "__anon_expr" + std::to_string(anonFuncNum);
+}
+
+// Symbol of the function running the n-th call evaluated at compile time.
+static std::string foldedCallName(int foldedCallNum) {
+    return "__folded_call" + std::to_string(foldedCallNum);
+}
+
+// Symbol of the n-th definition of a function, called through the stub named
+// after the function.
+static std::string versionedFunctionName(const std::string &name, int version) {
+    return name + "." + std::to_string(version);
+}
+
+// Symbol of the batch wrapper of a function, '.' cannot appear in a YAPL name.
+static std::string batchFunctionName(const std::string &name) {
+    return name + ".batch";
+}
+
+// Symbol of the loop calling a function for --bench.
+static std::string benchFunctionName(const std::string &name) {
+    return name + ".bench";
+}
+
+// Symbols of the result table of a memoized function version, and of its
+// hit and miss counters.
+static std::string memoTableName(const std::string &symbol) {
+    return symbol + ".memo";
+}
+
+static std::string memoStatsName(const std::string &symbol) {
+    return symbol + ".memo.stats";
+}
+
+// Symbol of the function storing the value of a global variable.
+static std::string initializerFunctionName(const std::string &name) {
+    return name + ".init";
+}
+
+static int getTokenPrecedence(int tok) {
     switch (tok) {
         case '<':
+        case '>':
+        case tok_cmp_eq:
+        case tok_cmp_ne:
+        case tok_cmp_le:
+        case tok_cmp_ge:
             return 10;
         case '+':
             return 20;
@@ -90,6 +248,28 @@ static std::string tokToString(int tok) {
             return "comma";
         case tok_eol:
             return "eol";
+        case tok_command:
+            return "command";
+        case tok_for:
+            return "for";
+        case tok_while:
+            return "while";
+        case tok_if:
+            return "if";
+        case tok_parallel:
+            return "parallel";
+        case tok_else:
+            return "else";
+        case tok_attribute:
+            return "attribute";
+        case tok_cmp_eq:
+            return "==";
+        case tok_cmp_ne:
+            return "!=";
+        case tok_cmp_le:
+            return "<=";
+        case tok_cmp_ge:
+            return ">=";
         case INT_MIN:
             return "IO Waiting";
     }
@@ -0,0 +1,75 @@
+//
+// Command line options of the yapl executable.
+//
+
+#pragma once
+
+#include <string>
+
+enum class JITLinker {
+    RTDyld,
+    JITLink
+};
+
+// Floating point semantics of the generated code.
+enum class FPMode {
+    // IEEE 754, every operation rounded as written.
+    Strict,
+    // a * b + c may be fused into one fma, rounded once.
+    Contract,
+    // Reassociation, no NaN nor infinity, approximate functions: all fast-math flags.
+    Fast
+};
+
+struct Options {
+    // Empty path means reading from stdin (REPL).
+    std::string inputPath = "";
+
+    bool timeReport = false;
+    std::string timeReportJSON = "";
+
+    bool statistics = false;
+
+    // JIT code symbolization for external profilers and debuggers.
+    bool perfMap = false;
+    bool perfJitDump = false;
+    bool gdbJIT = false;
+
+    // Emit DWARF line tables for the generated functions.
+    bool debugInfo = false;
+    bool profile = false;
+
+    JITLinker jitLinker = JITLinker::RTDyld;
+
+    // Functions declared strictmath, fpcontract or fastmath override it.
+    FPMode fpMode = FPMode::Strict;
+
+    // Parse the whole file before generating anything, and skip the
+    // functions the top level expressions never call.
+    bool wholeProgram = false;
+
+    // Read the AST of the file from its cache when the source did not
+    // change, write the cache otherwise. Parses the whole file first.
+    bool astCache = false;
+
+    // Entries of the result table of each pure function, rounded up to a
+    // power of two. 0 compiles pure functions without memoization.
+    unsigned memoSize = 1024;
+
+    // Evaluate the calls of side effect free functions with constant
+    // arguments while compiling, see IRGenerator::foldCall.
+    bool foldCalls = true;
+
+    // Call such as "kernel(1000, 2.5)" timed once the input ran, see Benchmark.
+    std::string benchCall = "";
+
+    // Write every optimized module to this bitcode file at exit.
+    std::string emitBitcode = "";
+    // Bitcode file written by emitBitcode, run before the input.
+    std::string loadBitcode = "";
+
+    // Serve REPL sessions on this Unix socket, see YAPLServer.
+    std::string serverSocket = "";
+    // Send the input to the server listening on this socket instead of running it.
+    std::string connectSocket = "";
+};
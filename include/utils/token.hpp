@@ -30,11 +30,34 @@ enum token {
     tok_pclose = -15,
     tok_bopen = -16,
     tok_bclose = -17,
-    tok_comma = -18
+    tok_comma = -18,
+
+    //REPL
+    tok_command = -19,
+
+    //control flow
+    tok_for = -20,
+    tok_while = -21,
+    tok_if = -22,
+    tok_else = -23,
+    tok_parallel = -29,
+
+    //comparisons of more than one character
+    tok_cmp_eq = -24,
+    tok_cmp_ne = -25,
+    tok_cmp_le = -26,
+    tok_cmp_ge = -27,
+
+    //function attributes, such as fastmath
+    tok_attribute = -28
 };
 
 struct Token {
     int token;
     std::string identifier = "";
     std::string valueStr = "";
+
+    // Position of the first character of the token, 1-based.
+    int line = 0;
+    int column = 0;
 };
@@ -8,5 +8,8 @@ enum type {
     type_int = 0,
     type_float = 1,
     type_char = 2,
-    type_void = 3
+    type_void = 3,
+    type_i16 = 4,
+    type_i64 = 5,
+    type_f32 = 6
 };
\ No newline at end of file
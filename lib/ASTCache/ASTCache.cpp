@@ -0,0 +1,611 @@
+#include "ASTCache/ASTCache.hpp"
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "Statistics/Statistics.hpp"
+
+YAPL_STATISTIC(NumCacheHits, "astcache", "ASTs read from a cache");
+YAPL_STATISTIC(NumCacheMisses, "astcache", "Missing, stale or corrupted caches");
+YAPL_STATISTIC(NumCacheBytesWritten, "astcache", "Bytes of AST cache written");
+
+namespace {
+
+enum class NodeKind : uint32_t {
+    Int,
+    Float,
+    Variable,
+    Vector,
+    BinaryOp,
+    Cast,
+    Call,
+    Conditional,
+    Assign,
+    For,
+    While,
+    ParallelFor,
+    If,
+    Return,
+    Declaration,
+    VariableDefinition,
+    // Only a child of a Prototype, named after the attribute.
+    Attribute,
+    Prototype,
+    FunctionDefinition,
+    AnonExpr,
+    Command,
+    Count
+};
+
+constexpr char s_Magic[8] = { 'Y', 'A', 'P', 'L', 'C', 0, 0, 0 };
+constexpr uint32_t s_NoNode = UINT32_MAX;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numStrings;
+    uint64_t sourceHash;
+    uint32_t numNodes;
+    uint32_t numChildren;
+    uint32_t numEntries;
+    uint32_t numCharacters;
+};
+
+struct StringRecord {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Children are the operands, then the statements of the lists of the node.
+struct NodeRecord {
+    // Literal bits: int64_t or double.
+    uint64_t value;
+    uint32_t kind;
+    uint32_t type;
+    // Identifier, callee or declared name.
+    uint32_t name;
+    uint32_t line;
+    uint32_t column;
+    uint32_t firstChild;
+    uint32_t numChildren;
+    // Operator of a BinaryOp, length of the then list of an If, number of
+    // parameters of a Prototype, variable type of a ParallelFor.
+    uint32_t extra;
+};
+
+static_assert(sizeof(CacheHeader) % 8 == 0 && sizeof(NodeRecord) % 8 == 0,
+              "The arrays following the header must stay aligned");
+
+class ASTWriter {
+private:
+    std::vector<StringRecord> m_Strings;
+    std::string m_Characters;
+    std::map<std::string, uint32_t> m_StringIndices;
+
+    std::vector<NodeRecord> m_Nodes;
+    std::vector<uint32_t> m_Children;
+
+    uint32_t addString(const std::string &str) {
+        auto index = m_StringIndices.emplace(str, m_Strings.size());
+
+        if (index.second) {
+            m_Strings.push_back({ static_cast<uint32_t>(m_Characters.size()), static_cast<uint32_t>(str.size()) });
+            m_Characters += str;
+        }
+
+        return index.first->second;
+    }
+
+public:
+    uint32_t write(const std::shared_ptr<ExprAST> &expr) {
+        if (!expr) {
+            return s_NoNode;
+        }
+
+        NodeRecord node{};
+        node.type = addString(expr->getType());
+        node.name = s_NoNode;
+        node.line = expr->getLine();
+        node.column = expr->getColumn();
+
+        std::vector<uint32_t> children;
+        auto add = [&](const std::shared_ptr<ExprAST> &child) { children.push_back(write(child)); };
+        auto addAll = [&](const auto &list) {
+            for (const auto &child : list) {
+                add(child);
+            }
+        };
+
+        auto kind = [&](NodeKind nodeKind) { node.kind = static_cast<uint32_t>(nodeKind); };
+
+        if (auto integer = std::dynamic_pointer_cast<IntExprAST>(expr)) {
+            kind(NodeKind::Int);
+            std::memcpy(&node.value, &integer->getValue().ival, sizeof(node.value));
+        } else if (auto floating = std::dynamic_pointer_cast<FloatExprAST>(expr)) {
+            kind(NodeKind::Float);
+            std::memcpy(&node.value, &floating->getValue().fval, sizeof(node.value));
+        } else if (auto variable = std::dynamic_pointer_cast<VariableExprAST>(expr)) {
+            kind(NodeKind::Variable);
+            node.name = addString(variable->getIdentifier());
+        } else if (auto vector = std::dynamic_pointer_cast<VectorExprAST>(expr)) {
+            kind(NodeKind::Vector);
+            addAll(vector->getElements());
+        } else if (auto binary = std::dynamic_pointer_cast<BinaryOpExprAST>(expr)) {
+            kind(NodeKind::BinaryOp);
+            node.extra = static_cast<uint32_t>(binary->getOp());
+            add(binary->getLHS());
+            add(binary->getRHS());
+        } else if (auto cast = std::dynamic_pointer_cast<CastExprAST>(expr)) {
+            kind(NodeKind::Cast);
+            add(cast->getValue());
+        } else if (auto call = std::dynamic_pointer_cast<CallFunctionExprAST>(expr)) {
+            kind(NodeKind::Call);
+            node.name = addString(call->getCallee());
+            addAll(call->getArgs());
+        } else if (auto conditional = std::dynamic_pointer_cast<ConditionalExprAST>(expr)) {
+            kind(NodeKind::Conditional);
+            add(conditional->getCondition());
+            add(conditional->getThen());
+            add(conditional->getElse());
+        } else if (auto assign = std::dynamic_pointer_cast<AssignExprAST>(expr)) {
+            kind(NodeKind::Assign);
+            node.name = addString(assign->getName());
+            add(assign->getValue());
+        } else if (auto loop = std::dynamic_pointer_cast<ForExprAST>(expr)) {
+            kind(NodeKind::For);
+            add(loop->getInit());
+            add(loop->getCondition());
+            add(loop->getStep());
+            addAll(loop->getBody());
+        } else if (auto loop = std::dynamic_pointer_cast<WhileExprAST>(expr)) {
+            kind(NodeKind::While);
+            add(loop->getCondition());
+            addAll(loop->getBody());
+        } else if (auto loop = std::dynamic_pointer_cast<ParallelForExprAST>(expr)) {
+            kind(NodeKind::ParallelFor);
+            node.name = addString(loop->getVariable());
+            node.extra = addString(loop->getVariableType());
+            add(loop->getBegin());
+            add(loop->getEnd());
+            addAll(loop->getBody());
+        } else if (auto ifExpr = std::dynamic_pointer_cast<IfExprAST>(expr)) {
+            kind(NodeKind::If);
+            node.extra = ifExpr->getThen().size();
+            add(ifExpr->getCondition());
+            addAll(ifExpr->getThen());
+            addAll(ifExpr->getElse());
+        } else if (auto returnExpr = std::dynamic_pointer_cast<ReturnExprAST>(expr)) {
+            kind(NodeKind::Return);
+            add(returnExpr->getValue());
+        } else if (auto proto = std::dynamic_pointer_cast<PrototypeAST>(expr)) {
+            kind(NodeKind::Prototype);
+            node.name = addString(proto->getName());
+            node.extra = proto->getParams().size();
+            addAll(proto->getParams());
+
+            for (const auto &attribute : proto->getAttributes()) {
+                NodeRecord attributeNode{};
+                attributeNode.kind = static_cast<uint32_t>(NodeKind::Attribute);
+                attributeNode.type = addString("");
+                attributeNode.name = addString(attribute);
+                attributeNode.firstChild = m_Children.size();
+
+                children.push_back(m_Nodes.size());
+                m_Nodes.push_back(attributeNode);
+            }
+        } else if (auto function = std::dynamic_pointer_cast<FunctionDefinitionAST>(expr)) {
+            kind(NodeKind::FunctionDefinition);
+            node.name = addString(function->getName());
+            add(function->getPrototype());
+            add(function->getReturnExpr());
+            addAll(function->getBlocks());
+        } else if (auto definition = std::dynamic_pointer_cast<VariableDefinitionAST>(expr)) {
+            kind(NodeKind::VariableDefinition);
+            node.name = addString(definition->getName());
+            add(definition->getValue());
+        } else if (auto declaration = std::dynamic_pointer_cast<DeclarationAST>(expr)) {
+            kind(NodeKind::Declaration);
+            node.name = addString(declaration->getName());
+        } else if (auto anonExpr = std::dynamic_pointer_cast<AnonExprAst>(expr)) {
+            kind(NodeKind::AnonExpr);
+            add(anonExpr->getExpr());
+            add(anonExpr->getProto());
+        } else if (auto command = std::dynamic_pointer_cast<CommandAST>(expr)) {
+            kind(NodeKind::Command);
+            node.name = addString(command->getName());
+        } else {
+            kind(NodeKind::Count);
+        }
+
+        node.firstChild = m_Children.size();
+        node.numChildren = children.size();
+        m_Children.insert(m_Children.end(), children.begin(), children.end());
+
+        m_Nodes.push_back(node);
+        return m_Nodes.size() - 1;
+    }
+
+    // Nodes of unknown kinds are written as Count, the cache is then not saved.
+    bool isComplete() const {
+        for (const auto &node : m_Nodes) {
+            if (node.kind == static_cast<uint32_t>(NodeKind::Count)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void save(llvm::raw_ostream &out, uint64_t sourceHash, const std::vector<uint32_t> &entries) const {
+        CacheHeader header{};
+        std::memcpy(header.magic, s_Magic, sizeof(s_Magic));
+        header.version = ASTCache::s_FormatVersion;
+        header.numStrings = m_Strings.size();
+        header.sourceHash = sourceHash;
+        header.numNodes = m_Nodes.size();
+        header.numChildren = m_Children.size();
+        header.numEntries = entries.size();
+        header.numCharacters = m_Characters.size();
+
+        auto writeArray = [&out](const void *data, size_t size) {
+            out.write(static_cast<const char *>(data), size);
+        };
+
+        writeArray(&header, sizeof(header));
+        writeArray(m_Strings.data(), m_Strings.size() * sizeof(StringRecord));
+        writeArray(m_Nodes.data(), m_Nodes.size() * sizeof(NodeRecord));
+        writeArray(m_Children.data(), m_Children.size() * sizeof(uint32_t));
+        writeArray(entries.data(), entries.size() * sizeof(uint32_t));
+        writeArray(m_Characters.data(), m_Characters.size());
+    }
+};
+
+// Builds the nodes in the order they are stored: the children of a node are
+// built before it, a child index not lower than its parent's is corrupted.
+class ASTReader {
+private:
+    llvm::ArrayRef<StringRecord> m_Strings;
+    llvm::ArrayRef<NodeRecord> m_Nodes;
+    llvm::ArrayRef<uint32_t> m_Children;
+    llvm::ArrayRef<uint32_t> m_Entries;
+    llvm::StringRef m_Characters;
+
+    std::vector<std::shared_ptr<ExprAST>> m_Built;
+
+    bool string(uint32_t index, std::string &str) const {
+        if (index >= m_Strings.size() ||
+                uint64_t(m_Strings[index].offset) + m_Strings[index].size > m_Characters.size()) {
+            return false;
+        }
+
+        str = m_Characters.substr(m_Strings[index].offset, m_Strings[index].size).str();
+        return true;
+    }
+
+    std::shared_ptr<ExprAST> build(uint32_t index) {
+        const NodeRecord &node = m_Nodes[index];
+        std::string type;
+        std::string name;
+
+        if (!string(node.type, type) || (node.name != s_NoNode && !string(node.name, name)) ||
+                uint64_t(node.firstChild) + node.numChildren > m_Children.size()) {
+            return nullptr;
+        }
+
+        std::vector<std::shared_ptr<ExprAST>> children;
+
+        for (uint32_t i = 0; i < node.numChildren; i++) {
+            uint32_t child = m_Children[node.firstChild + i];
+
+            if (child != s_NoNode && child >= index) {
+                return nullptr;
+            }
+
+            children.push_back(child == s_NoNode ? nullptr : m_Built[child]);
+        }
+
+        // The operands every kind requires, non null.
+        auto has = [&](size_t operands) {
+            if (children.size() < operands) {
+                return false;
+            }
+
+            for (size_t i = 0; i < operands; i++) {
+                if (!children[i]) {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        auto from = [&](size_t first) {
+            return std::vector<std::shared_ptr<ExprAST>>(children.begin() + first, children.end());
+        };
+
+        std::shared_ptr<ExprAST> expr;
+
+        switch (static_cast<NodeKind>(node.kind)) {
+            case NodeKind::Int: {
+                int64_t value;
+                std::memcpy(&value, &node.value, sizeof(value));
+                expr = std::make_shared<IntExprAST>(value, type);
+                break;
+            }
+            case NodeKind::Float: {
+                double value;
+                std::memcpy(&value, &node.value, sizeof(value));
+                expr = std::make_shared<FloatExprAST>(value, type);
+                break;
+            }
+            case NodeKind::Variable:
+                expr = std::make_shared<VariableExprAST>(type, name);
+                break;
+            case NodeKind::Vector:
+                if (has(children.size())) {
+                    expr = std::make_shared<VectorExprAST>(type, std::move(children));
+                }
+                break;
+            case NodeKind::BinaryOp:
+                if (has(2)) {
+                    expr = std::make_shared<BinaryOpExprAST>(static_cast<int>(node.extra), children[0], children[1]);
+                }
+                break;
+            case NodeKind::Cast:
+                if (has(1)) {
+                    expr = std::make_shared<CastExprAST>(type, children[0]);
+                }
+                break;
+            case NodeKind::Call:
+                if (has(children.size())) {
+                    expr = std::make_shared<CallFunctionExprAST>(type, name, std::move(children));
+                }
+                break;
+            case NodeKind::Conditional:
+                if (has(3)) {
+                    expr = std::make_shared<ConditionalExprAST>(children[0], children[1], children[2]);
+                }
+                break;
+            case NodeKind::Assign:
+                if (has(1)) {
+                    expr = std::make_shared<AssignExprAST>(name, children[0]);
+                }
+                break;
+            case NodeKind::For:
+                if (has(children.size())) {
+                    expr = std::make_shared<ForExprAST>(children[0], children[1], children[2], from(3));
+                }
+                break;
+            case NodeKind::While:
+                if (has(children.size()) && !children.empty()) {
+                    expr = std::make_shared<WhileExprAST>(children[0], from(1));
+                }
+                break;
+            case NodeKind::ParallelFor: {
+                std::string variableType;
+
+                if (has(children.size()) && children.size() >= 2 && string(node.extra, variableType)) {
+                    expr = std::make_shared<ParallelForExprAST>(name, variableType, children[0], children[1], from(2));
+                }
+                break;
+            }
+            case NodeKind::If:
+                if (has(children.size()) && !children.empty() && node.extra < children.size()) {
+                    auto then = std::vector<std::shared_ptr<ExprAST>>(children.begin() + 1, children.begin() + 1 + node.extra);
+                    expr = std::make_shared<IfExprAST>(children[0], std::move(then), from(1 + node.extra));
+                }
+                break;
+            case NodeKind::Return:
+                if (has(1)) {
+                    expr = std::make_shared<ReturnExprAST>(children[0]);
+                }
+                break;
+            case NodeKind::Declaration:
+            case NodeKind::Attribute:
+                expr = std::make_shared<DeclarationAST>(type, name);
+                break;
+            case NodeKind::VariableDefinition:
+                if (children.size() == 1) {
+                    expr = std::make_shared<VariableDefinitionAST>(type, name, children[0]);
+                }
+                break;
+            case NodeKind::Prototype: {
+                if (!has(children.size()) || node.extra > children.size()) {
+                    break;
+                }
+
+                auto declaration = std::make_shared<DeclarationAST>(type, name);
+                declaration->setLocation(node.line, node.column);
+
+                std::vector<std::shared_ptr<DeclarationAST>> params;
+                for (uint32_t i = 0; i < node.extra; i++) {
+                    params.push_back(std::dynamic_pointer_cast<DeclarationAST>(children[i]));
+
+                    if (!params.back()) {
+                        return nullptr;
+                    }
+                }
+
+                auto proto = std::make_shared<PrototypeAST>(std::move(declaration), std::move(params));
+
+                for (size_t i = node.extra; i < children.size(); i++) {
+                    if (m_Nodes[m_Children[node.firstChild + i]].kind != static_cast<uint32_t>(NodeKind::Attribute)) {
+                        return nullptr;
+                    }
+
+                    proto->addAttribute(std::static_pointer_cast<DeclarationAST>(children[i])->getName());
+                }
+
+                expr = std::move(proto);
+                break;
+            }
+            case NodeKind::FunctionDefinition: {
+                auto proto = children.size() >= 2 ? std::dynamic_pointer_cast<PrototypeAST>(children[0]) : nullptr;
+
+                // Functions without a return statement have no return expression.
+                if (proto && std::all_of(children.begin() + 2, children.end(),
+                                         [](const std::shared_ptr<ExprAST> &block) { return block != nullptr; })) {
+                    expr = std::make_shared<FunctionDefinitionAST>(std::move(proto), from(2), children[1]);
+                }
+                break;
+            }
+            case NodeKind::AnonExpr: {
+                auto proto = children.size() == 2 ? std::dynamic_pointer_cast<PrototypeAST>(children[1]) : nullptr;
+
+                if (proto && children[0]) {
+                    expr = std::make_shared<AnonExprAst>(children[0], std::move(proto));
+                }
+                break;
+            }
+            case NodeKind::Command:
+                expr = std::make_shared<CommandAST>(name);
+                break;
+            default:
+                break;
+        }
+
+        if (expr) {
+            expr->setLocation(node.line, node.column);
+        }
+
+        return expr;
+    }
+
+public:
+    // Checks the sizes of the arrays against the buffer, false if it is not a
+    // cache of the current format written from the given source.
+    bool map(llvm::StringRef buffer, uint64_t sourceHash) {
+        CacheHeader header;
+
+        if (buffer.size() < sizeof(header)) {
+            return false;
+        }
+
+        std::memcpy(&header, buffer.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, s_Magic, sizeof(s_Magic)) != 0 ||
+                header.version != ASTCache::s_FormatVersion || header.sourceHash != sourceHash) {
+            return false;
+        }
+
+        uint64_t size = sizeof(CacheHeader) + uint64_t(header.numStrings) * sizeof(StringRecord) +
+            uint64_t(header.numNodes) * sizeof(NodeRecord) +
+            (uint64_t(header.numChildren) + header.numEntries) * sizeof(uint32_t) + header.numCharacters;
+
+        // The records are read in place, from an aligned buffer.
+        if (size != buffer.size() || reinterpret_cast<uintptr_t>(buffer.data()) % alignof(NodeRecord) != 0) {
+            return false;
+        }
+
+        const char *data = buffer.data() + sizeof(CacheHeader);
+
+        m_Strings = llvm::makeArrayRef(reinterpret_cast<const StringRecord *>(data), header.numStrings);
+        data += header.numStrings * sizeof(StringRecord);
+        m_Nodes = llvm::makeArrayRef(reinterpret_cast<const NodeRecord *>(data), header.numNodes);
+        data += header.numNodes * sizeof(NodeRecord);
+        m_Children = llvm::makeArrayRef(reinterpret_cast<const uint32_t *>(data), header.numChildren);
+        data += header.numChildren * sizeof(uint32_t);
+        m_Entries = llvm::makeArrayRef(reinterpret_cast<const uint32_t *>(data), header.numEntries);
+        data += header.numEntries * sizeof(uint32_t);
+        m_Characters = llvm::StringRef(data, header.numCharacters);
+
+        return true;
+    }
+
+    bool read(std::vector<std::shared_ptr<ExprAST>> &entries) {
+        m_Built.reserve(m_Nodes.size());
+
+        for (uint32_t i = 0; i < m_Nodes.size(); i++) {
+            m_Built.push_back(build(i));
+
+            if (!m_Built.back()) {
+                return false;
+            }
+        }
+
+        for (uint32_t entry : m_Entries) {
+            if (entry >= m_Built.size()) {
+                return false;
+            }
+
+            entries.push_back(m_Built[entry]);
+        }
+
+        return true;
+    }
+};
+
+}
+
+std::string ASTCache::getCachePath(const std::string &sourcePath) {
+    return sourcePath + "c";
+}
+
+uint64_t ASTCache::hashSource(llvm::StringRef source) {
+    return llvm::xxHash64(source);
+}
+
+llvm::Expected<std::vector<std::shared_ptr<ExprAST>>> ASTCache::read(const std::string &path, uint64_t sourceHash) {
+    // Mapped rather than read when large enough.
+    auto buffer = llvm::MemoryBuffer::getFile(path, -1, false);
+
+    if (!buffer) {
+        ++NumCacheMisses;
+        return llvm::errorCodeToError(buffer.getError());
+    }
+
+    ASTReader reader;
+    std::vector<std::shared_ptr<ExprAST>> entries;
+
+    if (!reader.map((*buffer)->getBuffer(), sourceHash) || !reader.read(entries)) {
+        ++NumCacheMisses;
+        return llvm::make_error<llvm::StringError>("Stale or corrupted AST cache: " + path,
+                llvm::inconvertibleErrorCode());
+    }
+
+    ++NumCacheHits;
+
+    return entries;
+}
+
+llvm::Error ASTCache::write(const std::string &path, uint64_t sourceHash,
+                            const std::vector<std::shared_ptr<ExprAST>> &entries) {
+    ASTWriter writer;
+    std::vector<uint32_t> entryNodes;
+
+    for (const auto &entry : entries) {
+        entryNodes.push_back(writer.write(entry));
+    }
+
+    if (!writer.isComplete()) {
+        return llvm::make_error<llvm::StringError>("The AST cannot be cached", llvm::inconvertibleErrorCode());
+    }
+
+    // Written aside then renamed, a concurrent run never reads a partial cache.
+    std::string temporaryPath = path + ".tmp";
+    std::error_code error;
+
+    {
+        llvm::raw_fd_ostream out(temporaryPath, error, llvm::sys::fs::OF_None);
+
+        if (error) {
+            return llvm::errorCodeToError(error);
+        }
+
+        writer.save(out, sourceHash, entryNodes);
+        NumCacheBytesWritten += out.tell();
+    }
+
+    if ((error = llvm::sys::fs::rename(temporaryPath, path))) {
+        return llvm::errorCodeToError(error);
+    }
+
+    return llvm::Error::success();
+}
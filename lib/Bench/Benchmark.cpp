@@ -0,0 +1,148 @@
+#include "Bench/Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// User space cycles of the calling thread, counted by the CPU. Unavailable
+// outside of Linux, and when perf_event_paranoid or a container forbids it.
+class CycleCounter {
+private:
+    int m_FD = -1;
+
+public:
+    CycleCounter() {
+#ifdef __linux__
+        perf_event_attr attributes{};
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+
+        m_FD = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+    }
+
+    ~CycleCounter() {
+#ifdef __linux__
+        if (m_FD >= 0) {
+            close(m_FD);
+        }
+#endif
+    }
+
+    CycleCounter(const CycleCounter &) = delete;
+    CycleCounter &operator=(const CycleCounter &) = delete;
+
+    bool isAvailable() const { return m_FD >= 0; }
+
+    void start() {
+#ifdef __linux__
+        ioctl(m_FD, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_FD, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t cycles = 0;
+#ifdef __linux__
+        ioctl(m_FD, PERF_EVENT_IOC_DISABLE, 0);
+
+        if (read(m_FD, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+            return 0;
+        }
+#endif
+        return cycles;
+    }
+};
+
+static double timeLoop(Benchmark::Loop loop, int64_t iterations) {
+    auto start = Clock::now();
+    loop(iterations);
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+Benchmark::Result Benchmark::run(Loop loop) {
+    Result result;
+    int64_t iterations = 1;
+    double warmup = 0;
+
+    // Also compiles the functions called lazily, and fills the caches.
+    while (warmup < s_WarmupTime) {
+        double elapsed = timeLoop(loop, iterations);
+        warmup += elapsed;
+
+        if (elapsed < s_SampleTime) {
+            // Aims past s_SampleTime, to converge in a few runs.
+            double scale = elapsed > 0 ? 1.2 * s_SampleTime / elapsed : 2;
+            iterations = std::max(iterations + 1, static_cast<int64_t>(iterations * std::min(scale, 100.0)));
+        }
+    }
+
+    CycleCounter counter;
+    std::vector<double> samples;
+    uint64_t cycles = 0;
+    double total = 0;
+
+    while (samples.size() < s_MaxSamples && (samples.size() < s_MinSamples || total < s_MaxTime)) {
+        if (counter.isAvailable()) {
+            counter.start();
+        }
+
+        double elapsed = timeLoop(loop, iterations);
+
+        if (counter.isAvailable()) {
+            cycles += counter.stop();
+        }
+
+        total += elapsed;
+        samples.push_back(elapsed * 1e9 / iterations);
+    }
+
+    double mean = total * 1e9 / iterations / samples.size();
+    double variance = 0;
+
+    for (double sample : samples) {
+        variance += (sample - mean) * (sample - mean);
+    }
+
+    result.iterations = iterations;
+    result.samples = samples.size();
+    result.meanNs = mean;
+    result.stddevNs = std::sqrt(variance / (samples.size() - 1));
+    result.minNs = *std::min_element(samples.begin(), samples.end());
+
+    if (counter.isAvailable()) {
+        result.cycles = static_cast<double>(cycles) / iterations / samples.size();
+    }
+
+    return result;
+}
+
+void Benchmark::print(std::ostream &stream, const std::string &call, const Result &result) {
+    stream << std::fixed << std::setprecision(2)
+        << "bench " << call << ": " << result.meanNs << " ns/call +- " << result.stddevNs
+        << " (min " << result.minNs << ", " << result.samples << " samples of " << result.iterations << " calls)";
+
+    if (result.cycles >= 0) {
+        stream << ", " << result.cycles << " cycles/call";
+    } else {
+        stream << ", cycles unavailable";
+    }
+
+    stream << std::endl;
+    stream.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,82 @@
+#include "Embedding/YAPLEngine.hpp"
+
+#include "IRGenerator/IRGenerator.hpp"
+#include "Lexer/Lexer.hpp"
+#include "helper/helper.hpp"
+
+YAPLEngine::YAPLEngine(std::unique_ptr<IRGenerator> generator)
+    : m_Generator(std::move(generator))
+{}
+
+YAPLEngine::~YAPLEngine() = default;
+
+llvm::Expected<std::unique_ptr<YAPLEngine>> YAPLEngine::compile(const std::string &source, const Options &options) {
+    auto generator = std::make_unique<IRGenerator>(Lexer::fromSource(source), options);
+
+    if (auto err = generator->compile()) {
+        return err;
+    }
+
+    return std::unique_ptr<YAPLEngine>(new YAPLEngine(std::move(generator)));
+}
+
+static llvm::Error checkSignature(const PrototypeAST *prototype, const std::string &name,
+                                  const std::vector<std::string> &types) {
+    if (!prototype) {
+        return llvm::make_error<llvm::StringError>("Function not defined: " + name,
+                llvm::inconvertibleErrorCode());
+    }
+
+    std::vector<std::string> prototypeTypes = { prototype->getType() };
+    for (const auto &param : prototype->getParams()) {
+        prototypeTypes.push_back(param->getType());
+    }
+
+    if (prototypeTypes != types) {
+        return llvm::make_error<llvm::StringError>("Signature mismatch for function: " + name,
+                llvm::inconvertibleErrorCode());
+    }
+
+    return llvm::Error::success();
+}
+
+static llvm::Expected<void *> toAddress(llvm::Expected<llvm::JITEvaluatedSymbol> symbol) {
+    if (!symbol) {
+        return symbol.takeError();
+    }
+
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(symbol->getAddress()));
+}
+
+llvm::Expected<void *> YAPLEngine::getAddress(const std::string &name, const std::vector<std::string> &types) {
+    if (auto err = checkSignature(m_Generator->getPrototype(name).get(), name, types)) {
+        return err;
+    }
+
+    return toAddress(m_Generator->lookup(name));
+}
+
+llvm::Expected<void *> YAPLEngine::getBatchAddress(const std::string &name, const std::vector<std::string> &types) {
+    if (auto err = checkSignature(m_Generator->getPrototype(name).get(), name, types)) {
+        return err;
+    }
+
+    // The wrapper is generated on the first request only.
+    auto batch = m_BatchAddresses.find(name);
+
+    if (batch != m_BatchAddresses.end()) {
+        return batch->second;
+    }
+
+    if (auto err = m_Generator->generateBatch(name)) {
+        return err;
+    }
+
+    auto address = toAddress(m_Generator->lookup(batchFunctionName(name)));
+
+    if (address) {
+        m_BatchAddresses[name] = *address;
+    }
+
+    return address;
+}
@@ -15,330 +15,3217 @@
 #include "IRGenerator/IRGenerator.hpp"
 
 #include <cstdlib>
+#include <llvm/ADT/StringSwitch.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/PassTimingInfo.h>
 #include <llvm/IR/Type.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/raw_ostream.h>
-#include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cinttypes>
 #include <cstdio>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 
+#include "ASTCache/ASTCache.hpp"
+#include "Bench/Benchmark.hpp"
+#include "Logger/Logger.hpp"
+#include "Statistics/Statistics.hpp"
+#include "TimeReport/TimeReport.hpp"
+#include "helper/helper.hpp"
+
+YAPL_STATISTIC(NumFunctionDefs, "irgen", "Entries in the function table (m_FunctionDefs)");
+YAPL_STATISTIC(NumBatchWrappers, "irgen", "Batch wrappers generated");
+YAPL_STATISTIC(NumRedefinitions, "irgen", "Functions redefined");
+YAPL_STATISTIC(NumGlobals, "irgen", "Global variables defined");
+YAPL_STATISTIC(NumMemoizedFunctions, "irgen", "Pure functions memoized");
+YAPL_STATISTIC(NumFoldedCalls, "irgen", "Calls evaluated at compile time");
+YAPL_STATISTIC(NumUnreachableFunctions, "irgen", "Declarations skipped by --whole-program");
+YAPL_STATISTIC(NumMustTailCalls, "irgen", "Self-recursive calls in tail position marked musttail");
+YAPL_STATISTIC(NumParallelLoops, "irgen", "Parallel for loops outlined");
+YAPL_STATISTIC(NumNamedValuesPeak, "irgen", "Peak entries in the named values table (m_NamedValues)");
+
+template <typename Visitor>
+static void forEachExpr(const std::vector<std::shared_ptr<ExprAST>> &exprs, const Visitor &visit);
+
+// Calls visit on expr, then on every expression and statement nested in it.
+template <typename Visitor>
+static void forEachExpr(const std::shared_ptr<ExprAST> &expr, const Visitor &visit) {
+    if (!expr) {
+        return;
+    }
+
+    visit(expr);
+
+    if (auto binary = std::dynamic_pointer_cast<BinaryOpExprAST>(expr)) {
+        forEachExpr(binary->getLHS(), visit);
+        forEachExpr(binary->getRHS(), visit);
+    } else if (auto cast = std::dynamic_pointer_cast<CastExprAST>(expr)) {
+        forEachExpr(cast->getValue(), visit);
+    } else if (auto conditional = std::dynamic_pointer_cast<ConditionalExprAST>(expr)) {
+        forEachExpr(conditional->getCondition(), visit);
+        forEachExpr(conditional->getThen(), visit);
+        forEachExpr(conditional->getElse(), visit);
+    } else if (auto call = std::dynamic_pointer_cast<CallFunctionExprAST>(expr)) {
+        forEachExpr(call->getArgs(), visit);
+    } else if (auto vector = std::dynamic_pointer_cast<VectorExprAST>(expr)) {
+        forEachExpr(vector->getElements(), visit);
+    } else if (auto assign = std::dynamic_pointer_cast<AssignExprAST>(expr)) {
+        forEachExpr(assign->getValue(), visit);
+    } else if (auto definition = std::dynamic_pointer_cast<VariableDefinitionAST>(expr)) {
+        forEachExpr(definition->getValue(), visit);
+    } else if (auto anonExpr = std::dynamic_pointer_cast<AnonExprAst>(expr)) {
+        forEachExpr(anonExpr->getExpr(), visit);
+    } else if (auto function = std::dynamic_pointer_cast<FunctionDefinitionAST>(expr)) {
+        forEachExpr(function->getBlocks(), visit);
+        forEachExpr(function->getReturnExpr(), visit);
+    } else if (auto loop = std::dynamic_pointer_cast<ForExprAST>(expr)) {
+        forEachExpr(loop->getInit(), visit);
+        forEachExpr(loop->getCondition(), visit);
+        forEachExpr(loop->getStep(), visit);
+        forEachExpr(loop->getBody(), visit);
+    } else if (auto loop = std::dynamic_pointer_cast<WhileExprAST>(expr)) {
+        forEachExpr(loop->getCondition(), visit);
+        forEachExpr(loop->getBody(), visit);
+    } else if (auto loop = std::dynamic_pointer_cast<ParallelForExprAST>(expr)) {
+        forEachExpr(loop->getBegin(), visit);
+        forEachExpr(loop->getEnd(), visit);
+        forEachExpr(loop->getBody(), visit);
+    } else if (auto ifExpr = std::dynamic_pointer_cast<IfExprAST>(expr)) {
+        forEachExpr(ifExpr->getCondition(), visit);
+        forEachExpr(ifExpr->getThen(), visit);
+        forEachExpr(ifExpr->getElse(), visit);
+    } else if (auto returnExpr = std::dynamic_pointer_cast<ReturnExprAST>(expr)) {
+        forEachExpr(returnExpr->getValue(), visit);
+    }
+}
+
+template <typename Visitor>
+static void forEachExpr(const std::vector<std::shared_ptr<ExprAST>> &exprs, const Visitor &visit) {
+    for (const auto &expr : exprs) {
+        forEachExpr(expr, visit);
+    }
+}
+
+// Whether a return statement is nested in the statements.
+static bool containsReturn(const std::vector<std::shared_ptr<ExprAST>> &statements) {
+    bool hasReturn = false;
+
+    forEachExpr(statements, [&](const std::shared_ptr<ExprAST> &expr) {
+        hasReturn |= std::dynamic_pointer_cast<ReturnExprAST>(expr) != nullptr;
+    });
+
+    return hasReturn;
+}
+
+// Functions called by expr and the expressions nested in it.
+static std::set<std::string> collectCallees(const std::shared_ptr<ExprAST> &expr) {
+    std::set<std::string> callees;
+
+    forEachExpr(expr, [&callees](const std::shared_ptr<ExprAST> &nested) {
+        if (auto call = std::dynamic_pointer_cast<CallFunctionExprAST>(nested)) {
+            callees.insert(call->getCallee());
+        }
+    });
+
+    return callees;
+}
+
+// First global variable read or assigned by a function, locals and parameters
+// of the same name aside, empty if it uses none.
+static std::string findGlobalUse(const FunctionDefinitionAST &definition,
+                                 const std::map<std::string, std::string> &globals) {
+    std::set<std::string> locals;
+    std::string global;
+
+    for (const auto &param : definition.getPrototype()->getParams()) {
+        locals.insert(param->getName());
+    }
+
+    auto visit = [&](const std::shared_ptr<ExprAST> &expr) {
+        std::string used;
+
+        if (auto declaration = std::dynamic_pointer_cast<DeclarationAST>(expr)) {
+            locals.insert(declaration->getName());
+        } else if (auto loop = std::dynamic_pointer_cast<ParallelForExprAST>(expr)) {
+            locals.insert(loop->getVariable());
+        } else if (auto variable = std::dynamic_pointer_cast<VariableExprAST>(expr)) {
+            used = variable->getIdentifier();
+        } else if (auto assign = std::dynamic_pointer_cast<AssignExprAST>(expr)) {
+            used = assign->getName();
+        }
+
+        if (global.empty() && !locals.count(used) && globals.count(used)) {
+            global = used;
+        }
+    };
+
+    forEachExpr(definition.getBlocks(), visit);
+    forEachExpr(definition.getReturnExpr(), visit);
+
+    return global;
+}
+
+// Whether a function divides integers by anything but a non-zero literal,
+// which traps when the divisor is 0.
+static bool dividesByVariable(const FunctionDefinitionAST &definition) {
+    bool divides = false;
+
+    auto visit = [&divides](const std::shared_ptr<ExprAST> &expr) {
+        auto binary = std::dynamic_pointer_cast<BinaryOpExprAST>(expr);
+
+        if (!binary || binary->getOp() != '/' || !isIntegerType(binary->getType())) {
+            return;
+        }
+
+        auto divisor = std::dynamic_pointer_cast<IntExprAST>(binary->getRHS());
+        divides |= !divisor || divisor->getValue().ival == 0;
+    };
+
+    forEachExpr(definition.getBlocks(), visit);
+    forEachExpr(definition.getReturnExpr(), visit);
+
+    return divides;
+}
+
+static bool hasSameSignature(const PrototypeAST &proto, const PrototypeAST &other) {
+    if (proto.getType() != other.getType() || proto.getParams().size() != other.getParams().size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < proto.getParams().size(); i++) {
+        if (proto.getParams()[i]->getType() != other.getParams()[i]->getType()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The lazy call-through trampoline does not preserve the vector registers
+// in full, the vector arguments of a function's first call would be
+// corrupted.
+static bool hasVectorParameter(const llvm::Function *function) {
+    for (llvm::Type *paramType : function->getFunctionType()->params()) {
+        if (paramType->isVectorTy()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Prints a scalar of the given type stored at value.
+static void printValue(llvm::Type *type, const void *value) {
+    if (type->isDoubleTy()) {
+        fprintf(Logger::file(), "%f", *static_cast<const double *>(value));
+    } else if (type->isFloatTy()) {
+        fprintf(Logger::file(), "%f", *static_cast<const float *>(value));
+    } else if (type->isIntegerTy(64)) {
+        fprintf(Logger::file(), "%" PRId64, *static_cast<const int64_t *>(value));
+    } else if (type->isIntegerTy(16)) {
+        fprintf(Logger::file(), "%d", *static_cast<const int16_t *>(value));
+    } else if (type->isIntegerTy(8)) {
+        fprintf(Logger::file(), "%d", *static_cast<const int8_t *>(value));
+    } else {
+        fprintf(Logger::file(), "%d", *static_cast<const int32_t *>(value));
+    }
+}
+
+// Prints the result of a top level expression folded to a scalar integer or
+// floating point constant.
+static void printConstant(const llvm::Constant *constant) {
+    if (auto *integer = llvm::dyn_cast<llvm::ConstantInt>(constant)) {
+        fprintf(Logger::file(), "Evaluated to %" PRId64 "\n", integer->getSExtValue());
+    } else if (auto *real = llvm::dyn_cast<llvm::ConstantFP>(constant)) {
+        const llvm::APFloat &value = real->getValueAPF();
+        fprintf(Logger::file(), "Evaluated to %f\n",
+                real->getType()->isFloatTy() ? value.convertToFloat() : value.convertToDouble());
+    }
+}
+
+// Calls a top level expression returning a scalar of the given type, the
+// result is stored to value.
+static void callTopLevel(llvm::Type *type, uint64_t address, void *value) {
+    if (type->isDoubleTy()) {
+        *static_cast<double *>(value) = ((double(*)())(intptr_t)address)();
+    } else if (type->isFloatTy()) {
+        *static_cast<float *>(value) = ((float(*)())(intptr_t)address)();
+    } else if (type->isIntegerTy(64)) {
+        *static_cast<int64_t *>(value) = ((int64_t(*)())(intptr_t)address)();
+    } else if (type->isIntegerTy(16)) {
+        *static_cast<int16_t *>(value) = ((int16_t(*)())(intptr_t)address)();
+    } else if (type->isIntegerTy(8)) {
+        *static_cast<int8_t *>(value) = ((int8_t(*)())(intptr_t)address)();
+    } else {
+        *static_cast<int32_t *>(value) = ((int32_t(*)())(intptr_t)address)();
+    }
+}
+
 IRGenerator::IRGenerator(const char * argv)
-    :m_Lexer(std::make_shared<Lexer>(argv)), m_Parser(m_Lexer)
+    :IRGenerator(Options{argv})
+{}
+
+IRGenerator::IRGenerator(const Options &options)
+    :IRGenerator(std::make_shared<Lexer>(options.inputPath.c_str()), options)
+{}
+
+IRGenerator::IRGenerator(std::shared_ptr<Lexer> lexer, const Options &options, std::shared_ptr<SharedJIT> sharedJIT)
+    :m_Options(options), m_TSContext(std::make_unique<llvm::LLVMContext>()), m_Context(*m_TSContext.getContext()),
+    m_SharedJIT(std::move(sharedJIT)), m_Lexer(std::move(lexer)), m_Parser(m_Lexer)
 {
+    // Must be set before the first pass manager is created. Only written when
+    // set, concurrent sessions may be creating theirs.
+    if (m_Options.timeReport) {
+        llvm::TimePassesIsEnabled = true;
+    }
+
+    m_Module = std::make_unique<llvm::Module>("test", m_Context);
+    m_Builder = std::make_unique<llvm::IRBuilder<>>(m_Context);
+
+    if (!m_Options.emitBitcode.empty()) {
+        m_ExportModule = std::make_unique<llvm::Module>(m_Options.inputPath, m_Context);
+    }
+
+    createDebugInfo();
+}
+
+// The native target and the JIT are only set up by the first declaration or
+// expression to compile, the REPL prompt and commands do not wait for them.
+void IRGenerator::initializeJIT() {
+    if (m_YAPLJIT) {
+        return;
+    }
+
+    auto JitOrErr = m_SharedJIT ? YAPLJIT::CreateSession(m_SharedJIT) : YAPLJIT::Create(m_Options.jitLinker);
+
+    if (JitOrErr) {
+        m_YAPLJIT = std::move(JitOrErr.get());
+    } else {
+        llvm::logAllUnhandledErrors(JitOrErr.takeError(), Logger::llvmStream(), "Failed to create JIT: ");
+
+        exit(EXIT_FAILURE);
+    }
+
+    m_Module->setDataLayout(m_YAPLJIT->getDataLayout());
+    m_PassManager = std::make_unique<PassManager>(m_Module.get(), &m_YAPLJIT->getTargetMachine());
+
+    // The listeners of a shared JIT are registered once, by its owner.
+    if (m_SharedJIT) {
+        return;
+    }
+
+    if (m_Options.perfMap && !m_YAPLJIT->enablePerfMap()) {
+        Logger::stream() << "--perf-map requires the RuntimeDyld linker" << std::endl;
+    }
+
+    if (m_Options.perfJitDump && !m_YAPLJIT->enablePerfJitDump()) {
+        Logger::stream() << "--perf-jitdump requires the RuntimeDyld linker and LLVM built with LLVM_USE_PERF"
+            << std::endl;
+    }
+
+    if (m_Options.gdbJIT && !m_YAPLJIT->enableGDBRegistration()) {
+        Logger::stream() << "--gdb-jit requires the RuntimeDyld linker" << std::endl;
+    }
+
+    if (m_Options.profile) {
+        m_Profiler = std::make_unique<SourceProfiler>();
+
+        if (m_YAPLJIT->registerJITEventListener(*m_Profiler)) {
+            m_Profiler->start();
+        } else {
+            Logger::stream() << "--profile requires the RuntimeDyld linker" << std::endl;
+            m_Profiler = nullptr;
+        }
+    }
+}
+
+void IRGenerator::generate() {
+    if (!m_Options.loadBitcode.empty()) {
+        if (auto err = loadBitcode(m_Options.loadBitcode)) {
+            llvm::logAllUnhandledErrors(std::move(err), Logger::llvmStream(), "Failed to load the bitcode: ");
+        }
+    }
+
+    if ((m_Options.wholeProgram || m_Options.astCache) && m_Lexer->hasFile()) {
+        runProgram(loadProgram());
+    } else {
+        if (!m_Lexer->hasFile()) {
+            Logger::stream() << "(YAPL)>>>" << std::flush;
+        }
+        std::shared_ptr<ExprAST> expr;
+        {
+            TimeReport::Scope timer(Phase::Parse);
+            expr = m_Parser.parseNext();
+        }
+
+        while (!(std::dynamic_pointer_cast<EOFExprAST>(expr))) {
+            generateEntry(std::move(expr));
+
+            if (!m_Lexer->hasFile()) {
+                Logger::stream() << "(YAPL)>>>" << std::flush;
+            }
+
+            TimeReport::Scope timer(Phase::Parse);
+            expr = m_Parser.parseNext();
+        }
+    }
+
+    if (!m_Options.benchCall.empty()) {
+        if (auto err = benchmark(m_Options.benchCall)) {
+            llvm::logAllUnhandledErrors(std::move(err), Logger::llvmStream(), "Failed to benchmark: ");
+        }
+    }
+
+    if (m_ExportModule) {
+        if (auto err = writeBitcode(m_Options.emitBitcode)) {
+            llvm::logAllUnhandledErrors(std::move(err), Logger::llvmStream(), "Failed to write the bitcode: ");
+        }
+    }
+
+    if (m_Options.timeReport) {
+        reportTimings();
+    }
+
+    if (m_Options.statistics) {
+        Statistics::print(Logger::stream());
+        reportMemoization();
+    }
+
+    if (m_Profiler) {
+        m_Profiler->stop();
+        m_Profiler->printReport(Logger::stream());
+    }
+}
+
+std::vector<std::shared_ptr<ExprAST>> IRGenerator::parseProgram() {
+    std::vector<std::shared_ptr<ExprAST>> program;
+
+    for (auto expr = m_Parser.parseNext(); !std::dynamic_pointer_cast<EOFExprAST>(expr); expr = m_Parser.parseNext()) {
+        program.push_back(std::move(expr));
+    }
+
+    return program;
+}
+
+// The whole file, read from its AST cache with --cache when the source did
+// not change since it was written.
+std::vector<std::shared_ptr<ExprAST>> IRGenerator::loadProgram() {
+    TimeReport::Scope timer(Phase::Parse);
+
+    if (!m_Options.astCache) {
+        return parseProgram();
+    }
+
+    auto source = llvm::MemoryBuffer::getFile(m_Options.inputPath);
+    if (!source) {
+        return parseProgram();
+    }
+
+    std::string cachePath = ASTCache::getCachePath(m_Options.inputPath);
+    uint64_t sourceHash = ASTCache::hashSource((*source)->getBuffer());
+
+    auto cached = ASTCache::read(cachePath, sourceHash);
+    if (cached) {
+        return std::move(*cached);
+    }
+    llvm::consumeError(cached.takeError());
+
+    auto program = parseProgram();
+
+    if (std::find(program.begin(), program.end(), nullptr) == program.end()) {
+        if (auto err = ASTCache::write(cachePath, sourceHash, program)) {
+            llvm::logAllUnhandledErrors(std::move(err), Logger::llvmStream(), "Cannot write the AST cache: ");
+        }
+    }
+
+    return program;
+}
+
+// Runs the entries of the file in order. With --whole-program, skips the
+// functions that no top level expression can call.
+void IRGenerator::runProgram(std::vector<std::shared_ptr<ExprAST>> program) {
+    if (!m_Options.wholeProgram) {
+        for (auto &expr : program) {
+            generateEntry(std::move(expr));
+        }
+
+        return;
+    }
+
+    // Keyed by name, every definition of a reachable function is generated.
+    std::map<std::string, std::set<std::string>> callees;
+    std::vector<std::string> worklist;
+
+    auto functionName = [](const std::shared_ptr<ExprAST> &expr) -> std::string {
+        if (std::dynamic_pointer_cast<PrototypeAST>(expr) || std::dynamic_pointer_cast<FunctionDefinitionAST>(expr)) {
+            return std::static_pointer_cast<DeclarationAST>(expr)->getName();
+        }
+
+        return "";
+    };
+
+    for (const auto &expr : program) {
+        auto calls = collectCallees(expr);
+        std::string function = functionName(expr);
+
+        if (!function.empty()) {
+            callees[function].insert(calls.begin(), calls.end());
+        } else {
+            worklist.insert(worklist.end(), calls.begin(), calls.end());
+        }
+    }
+
+    std::set<std::string> reachable;
+
+    while (!worklist.empty()) {
+        std::string function = std::move(worklist.back());
+        worklist.pop_back();
+
+        if (reachable.insert(function).second) {
+            worklist.insert(worklist.end(), callees[function].begin(), callees[function].end());
+        }
+    }
+
+    for (auto &expr : program) {
+        std::string function = functionName(expr);
+
+        if (!function.empty() && !reachable.count(function)) {
+            ++NumUnreachableFunctions;
+            continue;
+        }
+
+        generateEntry(std::move(expr));
+    }
+}
+
+// Generates, compiles and runs one declaration, command or top level expression.
+void IRGenerator::generateEntry(std::shared_ptr<ExprAST> expr) {
+    if (auto parsedExpr = std::dynamic_pointer_cast<DeclarationAST>(expr)) {
+        YAPL_LOG(Debug) fprintf(Logger::file(), "Read declaration:\n");
+        std::string name = parsedExpr->getName();
+
+        {
+            TimeReport::Scope timer(Phase::JIT);
+            initializeJIT();
+        }
+
+        bool isFunction = std::dynamic_pointer_cast<PrototypeAST>(parsedExpr) ||
+            std::dynamic_pointer_cast<FunctionDefinitionAST>(parsedExpr);
+
+        llvm::Function *declaration = nullptr;
+        bool isGlobalDefined = false;
+        {
+            TimeReport::Scope timer(Phase::IRGen);
+
+            if (isFunction) {
+                declaration = generateDeclaration(std::move(parsedExpr));
+            } else {
+                isGlobalDefined = generateGlobal(std::move(parsedExpr));
+            }
+        }
+
+        if (declaration || isGlobalDefined) {
+            if (declaration) {
+                YAPL_LOG(Debug) declaration->print(Logger::llvmStream());
+            }
+
+            TimeReport::Scope timer(Phase::JIT);
+            if (auto err = addModuleToJIT()) {
+                llvm::logAllUnhandledErrors(std::move(err), Logger::llvmStream(), "Error while adding the module: ");
+            }
+        }
+
+        TimeReport::get().endEntry(name);
+    } else if (auto command = std::dynamic_pointer_cast<CommandAST>(expr)) {
+        runCommand(command->getName());
+    } else if (auto anonExpr = std::dynamic_pointer_cast<AnonExprAst>(expr)) {
+        YAPL_LOG(Debug) Logger::stream() << "Read top level:\n";
+        std::string name = anonExpr->getProto()->getName();
+
+        {
+            TimeReport::Scope timer(Phase::JIT);
+            initializeJIT();
+        }
+
+        llvm::Value *topLevel;
+        {
+            TimeReport::Scope timer(Phase::IRGen);
+            topLevel = generateTopLevel(std::move(expr));
+        }
+
+        if (topLevel) {
+            YAPL_LOG(Debug) {
+                topLevel->print(Logger::llvmStream());
+                fprintf(Logger::file(), "\n");
+            }
+
+            auto *function = llvm::cast<llvm::Function>(topLevel);
+            auto *returned = llvm::dyn_cast<llvm::ReturnInst>(&function->getEntryBlock().front());
+
+            // An expression folded to a constant needs neither the JIT nor running, unless exported.
+            if (returned && returned->getReturnValue() && !m_ExportModule) {
+                llvm::Value *value = returned->getReturnValue();
+
+                if (llvm::isa<llvm::ConstantInt>(value) || llvm::isa<llvm::ConstantFP>(value)) {
+                    YAPL_LOG(Info) printConstant(llvm::cast<llvm::Constant>(value));
+                    function->eraseFromParent();
+                    TimeReport::get().endEntry(name);
+                    return;
+                }
+            }
+
+            // The module, hence the function, is freed once compiled, its type is not.
+            auto type = static_cast<llvm::FunctionType *>(topLevel->getType()->getPointerElementType());
+
+            {
+                TimeReport::Scope timer(Phase::JIT);
+                if (auto err = addModuleToJIT()) {
+                    llvm::logAllUnhandledErrors(std::move(err), Logger::llvmStream(),
+                                                "Error while adding the module: ");
+                } else if (m_ExportModule) {
+                    m_ExportedEntries.push_back(name);
+                }
+            }
+
+            evaluateTopLevel(name, type);
+        }
+
+        TimeReport::get().endEntry(name);
+    }
+}
+
+// Runs a compiled top level expression and prints its result.
+void IRGenerator::evaluateTopLevel(const std::string &name, llvm::FunctionType *type) {
+    llvm::Type *returnType = type->getReturnType();
+    // Set when the vector result is stored through the only parameter.
+    llvm::FixedVectorType *vectorType = nullptr;
+
+    if (type->getNumParams() == 1) {
+        vectorType = llvm::dyn_cast<llvm::FixedVectorType>(type->getParamType(0)->getPointerElementType());
+    }
+
+    auto errOrSymbol = [&]() {
+        // Materialization is lazy, the lookup is what compiles the module.
+        TimeReport::Scope timer(Phase::JIT);
+        return m_YAPLJIT->lookup(name);
+    }();
+
+    if (!errOrSymbol) {
+        llvm::logAllUnhandledErrors(errOrSymbol.takeError(), Logger::llvmStream(), "Function not found: ");
+        return;
+    }
+
+    auto exprSymbol = errOrSymbol.get();
+
+    TimeReport::Scope timer(Phase::Execute);
+    if (vectorType) {
+        unsigned width = vectorType->getNumElements();
+        llvm::Type *elementType = vectorType->getElementType();
+        unsigned elementSize = elementType->getPrimitiveSizeInBits() / 8;
+        // uint64_t aligns the buffer for any element type.
+        std::vector<uint64_t> buffer(width);
+
+        void (*FP)(void *) = (void(*)(void *))(intptr_t)exprSymbol.getAddress();
+        FP(buffer.data());
+
+        YAPL_LOG(Info) {
+            fprintf(Logger::file(), "Evaluated to [");
+            for (unsigned i = 0; i < width; i++) {
+                fprintf(Logger::file(), "%s", i == 0 ? "" : ", ");
+                printValue(elementType, reinterpret_cast<const char *>(buffer.data()) + i * elementSize);
+            }
+            fprintf(Logger::file(), "]\n");
+        }
+    } else {
+        uint64_t value;
+        callTopLevel(returnType, exprSymbol.getAddress(), &value);
+
+        YAPL_LOG(Info) {
+            fprintf(Logger::file(), "Evaluated to ");
+            printValue(returnType, &value);
+            fprintf(Logger::file(), "\n");
+        }
+    }
+}
+
+// Compiles every declaration of the input into a single module and adds it to
+// the JIT, without printing nor executing anything. Used by the embedding API.
+llvm::Error IRGenerator::compile() {
+    initializeJIT();
+
+    for (auto expr = m_Parser.parseNext(); !std::dynamic_pointer_cast<EOFExprAST>(expr); expr = m_Parser.parseNext()) {
+        auto parsedDeclaration = std::dynamic_pointer_cast<DeclarationAST>(expr);
+
+        if (!parsedDeclaration) {
+            return llvm::make_error<llvm::StringError>(
+                    expr ? "Only declarations can be compiled, top level expressions are not supported" : "Syntax error",
+                    llvm::inconvertibleErrorCode());
+        }
+
+        bool isFunction = std::dynamic_pointer_cast<PrototypeAST>(parsedDeclaration) ||
+            std::dynamic_pointer_cast<FunctionDefinitionAST>(parsedDeclaration);
+
+        if (isFunction ? !generateDeclaration(parsedDeclaration) : !generateGlobal(parsedDeclaration)) {
+            return llvm::make_error<llvm::StringError>(
+                    "Failed to compile " + parsedDeclaration->getName(),
+                    llvm::inconvertibleErrorCode());
+        }
+    }
+
+    return addModuleToJIT();
+}
+
+// Generates `void name.batch(T0 *in0, ..., R *out, i64 count)` storing
+// name(in0[i], ...) to out[i] for every i < count. The scalar function and
+// the functions it calls are generated again, internal to the wrapper's
+// module, so that they are inlined in the loop which the vectorizer can then
+// widen. The wrapper is generated again when one of them is redefined.
+llvm::Error IRGenerator::generateBatch(const std::string &name) {
+    initializeJIT();
+
+    if (m_FunctionBodies.find(name) == m_FunctionBodies.end()) {
+        return llvm::make_error<llvm::StringError>("Function not defined: " + name,
+                llvm::inconvertibleErrorCode());
+    }
+
+    // Callees first, so that their callers find them in the module. A call
+    // closing a cycle goes through the stub.
+    std::vector<std::string> inlined;
+    std::set<std::string> visited;
+
+    std::function<void(const std::string &)> visit = [&](const std::string &function) {
+        if (!visited.insert(function).second || !m_FunctionBodies.count(function)) {
+            return;
+        }
+
+        for (const auto &callee : m_Callees[function]) {
+            visit(callee);
+        }
+
+        inlined.push_back(function);
+    };
+    visit(name);
+
+    llvm::Function *scalar = nullptr;
+
+    for (const auto &function : inlined) {
+        llvm::Function *copy = generateFunctionDefinition(m_FunctionBodies[function],
+                                                          versionedFunctionName(function, m_Versions[function]));
+
+        if (!copy) {
+            return llvm::make_error<llvm::StringError>("Failed to compile " + function,
+                    llvm::inconvertibleErrorCode());
+        }
+
+        copy->setLinkage(llvm::GlobalValue::InternalLinkage);
+        copy->addFnAttr(llvm::Attribute::AlwaysInline);
+
+        if (function == name) {
+            scalar = copy;
+        }
+    }
+
+    llvm::FunctionType *scalarType = scalar->getFunctionType();
+    llvm::Type *indexType = llvm::Type::getInt64Ty(m_Context);
+
+    std::vector<llvm::Type *> paramTypes;
+    for (auto *paramType : scalarType->params()) {
+        paramTypes.push_back(paramType->getPointerTo());
+    }
+    paramTypes.push_back(scalarType->getReturnType()->getPointerTo());
+    paramTypes.push_back(indexType);
+
+    std::string batchName = batchFunctionName(name);
+    int version = ++m_Versions[batchName];
+
+    llvm::Function *batch = llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context), paramTypes, false),
+            llvm::Function::ExternalLinkage,
+            versionedFunctionName(batchName, version),
+            m_Module.get());
+
+    // The input and output arrays never overlap.
+    for (unsigned i = 0; i + 1 < batch->arg_size(); i++) {
+        batch->addParamAttr(i, llvm::Attribute::NoAlias);
+    }
+
+    llvm::Value *count = batch->getArg(batch->arg_size() - 1);
+    llvm::Value *output = batch->getArg(scalar->arg_size());
+
+    llvm::BasicBlock *entryBlock = llvm::BasicBlock::Create(m_Context, "entry", batch);
+    llvm::BasicBlock *loopBlock = llvm::BasicBlock::Create(m_Context, "loop", batch);
+    llvm::BasicBlock *exitBlock = llvm::BasicBlock::Create(m_Context, "exit", batch);
+
+    m_Builder->SetInsertPoint(entryBlock);
+    m_Builder->CreateCondBr(
+            m_Builder->CreateICmpSGT(count, llvm::ConstantInt::get(indexType, 0)),
+            loopBlock,
+            exitBlock);
+
+    m_Builder->SetInsertPoint(loopBlock);
+    llvm::PHINode *index = m_Builder->CreatePHI(indexType, 2, "i");
+    index->addIncoming(llvm::ConstantInt::get(indexType, 0), entryBlock);
+
+    std::vector<llvm::Value *> args;
+    for (unsigned i = 0; i < scalar->arg_size(); i++) {
+        llvm::Type *elementType = scalarType->getParamType(i);
+        llvm::Value *element = m_Builder->CreateInBoundsGEP(elementType, batch->getArg(i), index);
+        args.push_back(m_Builder->CreateLoad(elementType, element));
+    }
+
+    llvm::Value *result = m_Builder->CreateCall(scalar, args);
+    m_Builder->CreateStore(result,
+            m_Builder->CreateInBoundsGEP(scalarType->getReturnType(), output, index));
+
+    llvm::Value *next = m_Builder->CreateAdd(index, llvm::ConstantInt::get(indexType, 1), "next", true, true);
+    index->addIncoming(next, loopBlock);
+    m_Builder->CreateCondBr(m_Builder->CreateICmpEQ(next, count), exitBlock, loopBlock);
+
+    m_Builder->SetInsertPoint(exitBlock);
+    m_Builder->CreateRetVoid();
+
+    llvm::verifyFunction(*batch);
+
+    {
+        TimeReport::Scope timer(Phase::Optimize);
+        m_PassManager->runVectorizer();
+    }
+
+    ++NumBatchWrappers;
+    m_BatchInlines[name] = std::set<std::string>(inlined.begin(), inlined.end());
+
+    if (auto err = addModuleToJIT()) {
+        return err;
+    }
+
+    if (auto err = m_YAPLJIT->defineStub(batchName, versionedFunctionName(batchName, version))) {
+        return err;
+    }
+
+    return m_YAPLJIT->isConcurrent() ? m_YAPLJIT->resolveStub(batchName) : llvm::Error::success();
+}
+
+llvm::Expected<llvm::JITEvaluatedSymbol> IRGenerator::lookup(const std::string &name) {
+    initializeJIT();
+
+    // Compiled now rather than on the first call through the stub, compilation
+    // errors are returned here.
+    auto version = m_Versions.find(name);
+
+    if (version != m_Versions.end()) {
+        auto implementation = m_YAPLJIT->lookup(versionedFunctionName(name, version->second));
+
+        if (!implementation) {
+            return implementation.takeError();
+        }
+    }
+
+    return m_YAPLJIT->lookup(name);
+}
+
+llvm::Error IRGenerator::clearJIT() {
+    return m_YAPLJIT ? m_YAPLJIT->clear() : llvm::Error::success();
+}
+
+std::shared_ptr<PrototypeAST> IRGenerator::getPrototype(const std::string &name) const {
+    auto funcDef = m_FunctionDefs.find(name);
+
+    return funcDef != m_FunctionDefs.end() ? funcDef->second : nullptr;
+}
+
+void IRGenerator::runCommand(const std::string &command) {
+    if (command == "stats") {
+        Statistics::print(Logger::stream());
+        reportMemoization();
+    } else {
+        Logger::stream() << "Unknown command: #" << command << std::endl;
+    }
+}
+
+// Hit rate of the result table of each memoized function since its last definition.
+void IRGenerator::reportMemoization() {
+    if (!m_Options.statistics) {
+        return;
+    }
+
+    for (const auto &memoized : m_Memoized) {
+        auto stats = m_YAPLJIT->lookup(memoStatsName(memoized.second));
+
+        if (!stats) {
+            llvm::consumeError(stats.takeError());
+            continue;
+        }
+
+        auto *counters = reinterpret_cast<const uint64_t *>(stats->getAddress());
+        uint64_t calls = counters[0] + counters[1];
+
+        fprintf(Logger::file(), "memo %s: %" PRIu64 " hits, %" PRIu64 " misses, %.1f%% hit rate\n",
+                memoized.first.c_str(), counters[0], counters[1], calls ? 100.0 * counters[0] / calls : 0.0);
+    }
+}
+
+void IRGenerator::reportTimings() {
+    auto &report = TimeReport::get();
+
+    report.print(Logger::stream());
+
+    if (!m_Options.timeReportJSON.empty()) {
+        report.writeJSON(m_Options.timeReportJSON);
+    }
+
+    llvm::reportAndResetTimings(&Logger::llvmStream());
+}
+
+/******************** ExprAST ********************************************/
+
+llvm::Value *IRGenerator::generateTopLevel(std::shared_ptr<ExprAST> parsedExpression) {
+    emitLocation(parsedExpression.get());
+
+    if (auto parsedNumber = std::dynamic_pointer_cast<NumberExprAST>(parsedExpression)) {
+        llvm::Type *type = getLLVMType(parsedNumber->getType());
+
+        if (std::dynamic_pointer_cast<IntExprAST>(parsedNumber)) {
+            return llvm::ConstantInt::get(type, parsedNumber->getValue().ival, true);
+        }
+        if (std::dynamic_pointer_cast<FloatExprAST>(parsedNumber)) {
+            // Rounded once, from the double the literal was parsed to.
+            return llvm::ConstantFP::get(type, parsedNumber->getValue().fval);
+        }
+        Logger::stream() << "Number expression not recognized" << std::endl;
+        return nullptr;
+    }
+
+    if (auto anonExpr = std::dynamic_pointer_cast<AnonExprAst>(parsedExpression)) {
+        auto functionBlocks = std::vector<std::shared_ptr<ExprAST>>();
+        auto returnExpr = anonExpr->getExpr();
+
+        // Assigning a global evaluates to its new value.
+        if (auto assignment = std::dynamic_pointer_cast<AssignExprAST>(returnExpr)) {
+            functionBlocks.push_back(assignment);
+            returnExpr = std::make_shared<VariableExprAST>(assignment->getType(), assignment->getName());
+        }
+
+        auto anonFuncExpr = std::make_shared<FunctionDefinitionAST>(anonExpr->getProto(),
+                std::move(functionBlocks), std::move(returnExpr));
+
+        auto function = generateFunctionDefinition(std::move(anonFuncExpr), anonExpr->getProto()->getName());
+
+        if (function && function->getReturnType()->isVectorTy()) {
+            return generateVectorResult(function);
+        }
+
+        return function;
+    }
+
+    if (auto parsedVector = std::dynamic_pointer_cast<VectorExprAST>(parsedExpression)) {
+        return generateVector(std::move(parsedVector));
+    }
+
+    if (auto parsedVariable = std::dynamic_pointer_cast<VariableExprAST>(parsedExpression)) {
+        llvm::Value *variable = getVariable(parsedVariable->getIdentifier());
+        if (!variable) {
+            Logger::stream() << "Unknown variable: " << parsedVariable->getIdentifier() << std::endl;
+            return nullptr;
+        }
+
+        return m_Builder->CreateLoad(variable->getType()->getPointerElementType(), variable,
+                                     parsedVariable->getIdentifier());
+    }
+
+    if (auto parsedBin = std::dynamic_pointer_cast<BinaryOpExprAST>(parsedExpression)) {
+        return generateBinary(std::move(parsedBin));
+    }
+
+    if (auto parsedConditional = std::dynamic_pointer_cast<ConditionalExprAST>(parsedExpression)) {
+        return generateConditional(std::move(parsedConditional));
+    }
+
+    if (auto parsedCast = std::dynamic_pointer_cast<CastExprAST>(parsedExpression)) {
+        return generateCast(std::move(parsedCast));
+    }
+
+    if (auto parsedCall = std::dynamic_pointer_cast<CallFunctionExprAST>(parsedExpression)) {
+        auto call = generateFunctionCall(std::move(parsedCall));
+        return call;
+    }
+
+    return nullptr;
+}
+
+llvm::Value *IRGenerator::generateVector(std::shared_ptr<VectorExprAST> parsedVector) {
+    llvm::Type *type = getLLVMType(parsedVector->getType());
+
+    if (!type) {
+        Logger::stream() << "Unknown vector type: " << parsedVector->getType() << std::endl;
+        return nullptr;
+    }
+
+    llvm::Value *vector = llvm::UndefValue::get(type);
+    const auto &elements = parsedVector->getElements();
+
+    for (size_t i = 0; i < elements.size(); i++) {
+        llvm::Value *element = generateTopLevel(elements[i]);
+
+        if (!element) {
+            return nullptr;
+        }
+
+        vector = m_Builder->CreateInsertElement(vector, element, m_Builder->getInt32(i));
+    }
+
+    return vector;
+}
+
+// The host cannot portably receive a vector by value, a vector top level
+// expression is wrapped in `void name(T *out)` storing it to out. The
+// expression itself is renamed name.vector.
+llvm::Function *IRGenerator::generateVectorResult(llvm::Function *function) {
+    std::string name = function->getName().str();
+    function->setName(name + ".vector");
+    function->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+    auto *vectorType = llvm::cast<llvm::FixedVectorType>(function->getReturnType());
+
+    llvm::Function *wrapper = llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context), {vectorType->getPointerTo()}, false),
+            llvm::Function::ExternalLinkage,
+            name,
+            m_Module.get());
+
+    m_Builder->SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", wrapper));
+
+    // The host buffer is only aligned for the elements.
+    m_Builder->CreateAlignedStore(
+            m_Builder->CreateCall(function),
+            wrapper->getArg(0),
+            llvm::MaybeAlign(m_Module->getDataLayout().getABITypeAlignment(vectorType->getElementType())));
+    m_Builder->CreateRetVoid();
+
+    llvm::verifyFunction(*wrapper);
+
+    return wrapper;
+}
+
+llvm::Value *IRGenerator::generateBinary(std::shared_ptr<BinaryOpExprAST> parsedBinaryOpExpr) {
+    int op = parsedBinaryOpExpr->getOp();
+
+    auto LHS = parsedBinaryOpExpr->getLHS();
+    auto RHS = parsedBinaryOpExpr->getRHS();
+
+    llvm::Value *L = generateTopLevel(std::move(LHS));
+    llvm::Value *R = generateTopLevel(std::move(RHS));
+
+    if(!L || !R)
+        return nullptr;
+
+    emitLocation(parsedBinaryOpExpr.get());
+
+    // Vector operations are element-wise, a scalar operand is broadcast.
+    auto *LVector = llvm::dyn_cast<llvm::FixedVectorType>(L->getType());
+    auto *RVector = llvm::dyn_cast<llvm::FixedVectorType>(R->getType());
+
+    if (LVector && RVector && LVector != RVector) {
+        Logger::stream() << "Mismatched vector operands" << std::endl;
+        return nullptr;
+    }
+
+    if (LVector && !RVector) {
+        R = m_Builder->CreateVectorSplat(LVector->getNumElements(), R, "splat");
+    } else if (RVector && !LVector) {
+        L = m_Builder->CreateVectorSplat(RVector->getNumElements(), L, "splat");
+    }
+
+    if (L->getType() != R->getType()) {
+        R->mutateType(L->getType());
+    }
+
+
+    if (L->getType()->isFPOrFPVectorTy()) {
+        switch (op) {
+            case '+':
+                return m_Builder->CreateFAdd(L, R, "addtmp");
+            case '-':
+                return m_Builder->CreateFSub(L, R, "subtmp");
+            case '*':
+                return m_Builder->CreateFMul(L, R, "multmp");
+            case '<':
+                L = m_Builder->CreateFCmpULT(L, R, "cmptmp");
+                break;
+            case '>':
+                L = m_Builder->CreateFCmpUGT(L, R, "cmptmp");
+                break;
+            case tok_cmp_le:
+                L = m_Builder->CreateFCmpULE(L, R, "cmptmp");
+                break;
+            case tok_cmp_ge:
+                L = m_Builder->CreateFCmpUGE(L, R, "cmptmp");
+                break;
+            case tok_cmp_eq:
+                L = m_Builder->CreateFCmpOEQ(L, R, "cmptmp");
+                break;
+            case tok_cmp_ne:
+                L = m_Builder->CreateFCmpUNE(L, R, "cmptmp");
+                break;
+            default:
+                Logger::stream() << "Invalid binary operator" << std::endl;
+                return nullptr;
+        }
+
+        // Comparisons give 1.0 or 0.0.
+        return m_Builder->CreateUIToFP(L, R->getType(), "booltmp");
+    } else {
+        switch (op) {
+            case '+':
+                return m_Builder->CreateAdd(L, R, "addtmp");
+            case '-':
+                return m_Builder->CreateSub(L, R, "subtmp");
+            case '*':
+                return m_Builder->CreateMul(L, R, "multmp");
+            case '<':
+                L = m_Builder->CreateICmpSLT(L, R, "cmptmp");
+                break;
+            case '>':
+                L = m_Builder->CreateICmpSGT(L, R, "cmptmp");
+                break;
+            case tok_cmp_le:
+                L = m_Builder->CreateICmpSLE(L, R, "cmptmp");
+                break;
+            case tok_cmp_ge:
+                L = m_Builder->CreateICmpSGE(L, R, "cmptmp");
+                break;
+            case tok_cmp_eq:
+                L = m_Builder->CreateICmpEQ(L, R, "cmptmp");
+                break;
+            case tok_cmp_ne:
+                L = m_Builder->CreateICmpNE(L, R, "cmptmp");
+                break;
+            default:
+                Logger::stream() << "Invalid binary operator" << std::endl;
+                return nullptr;
+        }
+
+        return m_Builder->CreateZExt(L, R->getType(), "booltmp");
+    }
+
+}
+
+// Integers are signed: they are sign extended and converted from and to
+// floating point as such.
+llvm::Value *IRGenerator::generateCast(std::shared_ptr<CastExprAST> parsedCast) {
+    llvm::Value *value = generateTopLevel(parsedCast->getValue());
+    llvm::Type *type = getLLVMType(parsedCast->getType());
+
+    if (!value || !type) {
+        return nullptr;
+    }
+
+    emitLocation(parsedCast.get());
+
+    bool isFromFloat = value->getType()->isFPOrFPVectorTy();
+    bool isToFloat = type->isFPOrFPVectorTy();
+
+    if (isFromFloat && isToFloat) {
+        return m_Builder->CreateFPCast(value, type, "casttmp");
+    }
+    if (isFromFloat) {
+        return m_Builder->CreateFPToSI(value, type, "casttmp");
+    }
+    if (isToFloat) {
+        return m_Builder->CreateSIToFP(value, type, "casttmp");
+    }
+
+    return m_Builder->CreateSExtOrTrunc(value, type, "casttmp");
+}
+
+// Only the selected operand is evaluated, the two values meet in a phi.
+llvm::Value *IRGenerator::generateConditional(std::shared_ptr<ConditionalExprAST> parsedConditional) {
+    llvm::Value *condition = generateCondition(parsedConditional->getCondition());
+
+    if (!condition) {
+        return nullptr;
+    }
+
+    llvm::Function *function = m_Builder->GetInsertBlock()->getParent();
+
+    llvm::BasicBlock *thenBlock = llvm::BasicBlock::Create(m_Context, "cond.then", function);
+    llvm::BasicBlock *elseBlock = llvm::BasicBlock::Create(m_Context, "cond.else", function);
+    llvm::BasicBlock *endBlock = llvm::BasicBlock::Create(m_Context, "cond.end", function);
+
+    m_Builder->CreateCondBr(condition, thenBlock, elseBlock);
+
+    bool alwaysRuns = m_AlwaysRuns;
+    m_AlwaysRuns = false;
+
+    m_Builder->SetInsertPoint(thenBlock);
+    llvm::Value *thenValue = generateTopLevel(parsedConditional->getThen());
+
+    if (!thenValue) {
+        return nullptr;
+    }
+
+    // A nested conditional moves the insertion point.
+    thenBlock = m_Builder->GetInsertBlock();
+    m_Builder->CreateBr(endBlock);
+
+    m_Builder->SetInsertPoint(elseBlock);
+    llvm::Value *elseValue = generateTopLevel(parsedConditional->getElse());
+
+    if (!elseValue) {
+        return nullptr;
+    }
+
+    elseBlock = m_Builder->GetInsertBlock();
+    m_Builder->CreateBr(endBlock);
+
+    m_AlwaysRuns = alwaysRuns;
+
+    m_Builder->SetInsertPoint(endBlock);
+    llvm::PHINode *phi = m_Builder->CreatePHI(thenValue->getType(), 2, "condtmp");
+    phi->addIncoming(thenValue, thenBlock);
+    phi->addIncoming(elseValue, elseBlock);
+
+    return phi;
+}
+
+llvm::Value *IRGenerator::generateFunctionCall(std::shared_ptr<CallFunctionExprAST> parsedFunctionCall) {
+    const std::string &callee = parsedFunctionCall->getCallee();
+
+    // Builtins, whether declared or not, unless the program defines its own.
+    if (m_FunctionBodies.find(callee) == m_FunctionBodies.end()) {
+        if (isReduction(callee) && parsedFunctionCall->getArgs().size() == 1) {
+            return generateReduction(std::move(parsedFunctionCall));
+        }
+
+        if (isMathBuiltin(callee)) {
+            return generateMathBuiltin(std::move(parsedFunctionCall));
+        }
+    }
+
+    llvm::Function *calleeFunction = getFunction(callee);
+
+    if (!calleeFunction) {
+        Logger::stream() << "Unknown function called" << std::endl;
+        return nullptr;
+    }
+
+    auto args = parsedFunctionCall->getArgs();
+    std::vector<llvm::Value *> callArgs;
+    if (calleeFunction->arg_size() != args.size()) {
+        return nullptr;
+    }
+
+    for (const auto &arg : args) {
+        llvm::Value *argVal = generateTopLevel(std::move(arg));
+        callArgs.push_back(argVal);
+
+        if(!callArgs.back()) {
+            return nullptr;
+        }
+    }
+
+    if (m_Options.foldCalls && m_AlwaysRuns) {
+        if (llvm::Constant *result = foldCall(callee, calleeFunction, callArgs)) {
+            return result;
+        }
+    }
+
+    emitLocation(parsedFunctionCall.get());
+    return m_Builder->CreateCall(calleeFunction, callArgs, "calltmp");
+}
+
+/*
+ * Evaluates a call whose arguments are all scalar constants, to a function
+ * without side effects whose code, and the code of every function it calls,
+ * is already in the JIT: a small function returning the call is compiled and
+ * run, and its result replaces the call. Results are kept until a function
+ * is redefined.
+ *
+ * Only calls running whenever their function does are folded, see
+ * m_AlwaysRuns: a call in a branch never taken, such as fact(-1) guarded by
+ * a test of the argument, would otherwise run, and maybe never return,
+ * while compiling. The call still runs in the compiler's thread, unguarded:
+ * a callee that does not terminate for these arguments hangs the compilation,
+ * and one recursing deeper than the stack, without tail calls, crashes it.
+ */
+llvm::Constant *IRGenerator::foldCall(const std::string &name, llvm::Function *callee,
+                                      const std::vector<llvm::Value *> &args) {
+    llvm::Type *returnType = callee->getReturnType();
+
+    if (!returnType->isIntegerTy() && !returnType->isFloatingPointTy()) {
+        return nullptr;
+    }
+
+    std::vector<llvm::Constant *> constants;
+
+    for (auto *arg : args) {
+        if (!llvm::isa<llvm::ConstantInt>(arg) && !llvm::isa<llvm::ConstantFP>(arg)) {
+            return nullptr;
+        }
+
+        constants.push_back(llvm::cast<llvm::Constant>(arg));
+    }
+
+    std::set<std::string> callees;
+
+    if (!isSideEffectFree(name, callees)) {
+        return nullptr;
+    }
+
+    m_FoldedCallees.insert(callees.begin(), callees.end());
+
+    auto key = std::make_pair(name, constants);
+    auto folded = m_FoldedCalls.find(key);
+
+    if (folded != m_FoldedCalls.end()) {
+        ++NumFoldedCalls;
+        return folded->second;
+    }
+
+    // Calls the function through its stub, the constants belong to m_Context.
+    std::string symbol = foldedCallName(++m_FoldedCallCount);
+    auto module = std::make_unique<llvm::Module>(symbol, m_Context);
+    module->setDataLayout(m_YAPLJIT->getDataLayout());
+
+    auto *declaration = llvm::Function::Create(callee->getFunctionType(), llvm::Function::ExternalLinkage,
+                                               name, module.get());
+    auto *function = llvm::Function::Create(llvm::FunctionType::get(returnType, false),
+                                            llvm::Function::ExternalLinkage, symbol, module.get());
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(m_Context, "entry", function));
+    builder.CreateRet(builder.CreateCall(declaration, args));
+
+    auto errOrSymbol = [&]() -> llvm::Expected<llvm::JITEvaluatedSymbol> {
+        TimeReport::Scope timer(Phase::JIT);
+
+        if (auto err = m_YAPLJIT->addModule(llvm::orc::ThreadSafeModule(std::move(module), m_TSContext))) {
+            return err;
+        }
+
+        return m_YAPLJIT->lookup(symbol);
+    }();
+
+    if (!errOrSymbol) {
+        llvm::logAllUnhandledErrors(errOrSymbol.takeError(), Logger::llvmStream(),
+                                    "Failed to fold a call to " + name + ": ");
+        return nullptr;
+    }
+
+    uint64_t value;
+    {
+        TimeReport::Scope timer(Phase::Execute);
+        callTopLevel(returnType, errOrSymbol->getAddress(), &value);
+    }
+
+    llvm::Constant *result;
+
+    if (returnType->isDoubleTy()) {
+        result = llvm::ConstantFP::get(returnType, *reinterpret_cast<double *>(&value));
+    } else if (returnType->isFloatTy()) {
+        result = llvm::ConstantFP::get(returnType, *reinterpret_cast<float *>(&value));
+    } else if (returnType->isIntegerTy(64)) {
+        result = llvm::ConstantInt::get(returnType, *reinterpret_cast<int64_t *>(&value), true);
+    } else if (returnType->isIntegerTy(16)) {
+        result = llvm::ConstantInt::get(returnType, *reinterpret_cast<int16_t *>(&value), true);
+    } else if (returnType->isIntegerTy(8)) {
+        result = llvm::ConstantInt::get(returnType, *reinterpret_cast<int8_t *>(&value), true);
+    } else {
+        result = llvm::ConstantInt::get(returnType, *reinterpret_cast<int32_t *>(&value), true);
+    }
+
+    ++NumFoldedCalls;
+    m_FoldedCalls[key] = result;
+    return result;
+}
+
+// Whether name calls a function declared by a prototype only, which is
+// neither a builtin nor a function of the process: a function defined later.
+bool IRGenerator::callsUndefinedFunction(const std::string &name) {
+    for (const auto &callee : m_Callees[name]) {
+        if (!m_Versions.count(callee) && !isMathBuiltin(callee) && !isReduction(callee) &&
+                !llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(callee)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Whether name and the functions it calls, added to visited, only compute
+// their result from their arguments: YAPL functions already in the JIT that
+// use no global variable, and builtins. External functions may have any
+// effect. A function dividing integers by a variable may trap, which would
+// crash the compiler rather than its caller, and is not run either.
+bool IRGenerator::isSideEffectFree(const std::string &name, std::set<std::string> &visited) {
+    // Recursive calls are decided by the first visit.
+    if (!visited.insert(name).second) {
+        return true;
+    }
+
+    auto body = m_FunctionBodies.find(name);
+
+    if (body == m_FunctionBodies.end()) {
+        visited.erase(name);
+        return isMathBuiltin(name) || isReduction(name);
+    }
+
+    if (m_Module->getFunction(versionedFunctionName(name, m_Versions[name]))) {
+        return false;
+    }
+
+    if (!findGlobalUse(*body->second, m_Globals).empty() || dividesByVariable(*body->second)) {
+        return false;
+    }
+
+    for (const auto &callee : m_Callees[name]) {
+        if (!isSideEffectFree(callee, visited)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Math functions lowered to intrinsics rather than calls to the C library:
+// they are constant folded, vectorized, and sqrt and fma become single
+// instructions. min and max of integers are selects.
+llvm::Value *IRGenerator::generateMathBuiltin(std::shared_ptr<CallFunctionExprAST> parsedFunctionCall) {
+    const std::string &callee = parsedFunctionCall->getCallee();
+    const auto &args = parsedFunctionCall->getArgs();
+
+    if (args.size() != mathBuiltinArity(callee)) {
+        Logger::stream() << callee << "() expects " << mathBuiltinArity(callee) << " arguments" << std::endl;
+        return nullptr;
+    }
+
+    std::vector<llvm::Value *> values;
+
+    for (const auto &arg : args) {
+        values.push_back(generateTopLevel(arg));
+
+        if (!values.back()) {
+            return nullptr;
+        }
+    }
+
+    emitLocation(parsedFunctionCall.get());
+
+    llvm::Type *type = values[0]->getType();
+
+    if ((callee == "min" || callee == "max") && !type->isFPOrFPVectorTy()) {
+        llvm::Value *isFirst = callee == "min" ?
+            m_Builder->CreateICmpSLT(values[0], values[1]) :
+            m_Builder->CreateICmpSGT(values[0], values[1]);
+
+        return m_Builder->CreateSelect(isFirst, values[0], values[1], callee);
+    }
+
+    llvm::Intrinsic::ID intrinsic = llvm::StringSwitch<llvm::Intrinsic::ID>(callee)
+        .Case("sqrt", llvm::Intrinsic::sqrt)
+        .Case("exp", llvm::Intrinsic::exp)
+        .Case("log", llvm::Intrinsic::log)
+        .Case("pow", llvm::Intrinsic::pow)
+        .Case("fabs", llvm::Intrinsic::fabs)
+        .Case("fma", llvm::Intrinsic::fma)
+        .Case("min", llvm::Intrinsic::minnum)
+        .Case("max", llvm::Intrinsic::maxnum);
+
+    return m_Builder->CreateIntrinsic(intrinsic, {type}, values, nullptr, callee);
+}
+
+// sum(), product(), min() and max() of a vector, lowered to the vector reduce
+// intrinsics.
+llvm::Value *IRGenerator::generateReduction(std::shared_ptr<CallFunctionExprAST> parsedFunctionCall) {
+    const std::string &callee = parsedFunctionCall->getCallee();
+    const auto &args = parsedFunctionCall->getArgs();
+
+    if (args.size() != 1) {
+        Logger::stream() << callee << "() expects a single vector argument" << std::endl;
+        return nullptr;
+    }
+
+    llvm::Value *vector = generateTopLevel(args[0]);
+
+    if (!vector) {
+        return nullptr;
+    }
+
+    auto *vectorType = llvm::dyn_cast<llvm::FixedVectorType>(vector->getType());
+
+    if (!vectorType) {
+        Logger::stream() << callee << "() expects a single vector argument" << std::endl;
+        return nullptr;
+    }
+
+    emitLocation(parsedFunctionCall.get());
+
+    llvm::Type *elementType = vectorType->getElementType();
+
+    if (elementType->isFloatingPointTy()) {
+        if (callee == "sum") {
+            return m_Builder->CreateFAddReduce(llvm::ConstantFP::getNegativeZero(elementType), vector);
+        }
+        if (callee == "product") {
+            return m_Builder->CreateFMulReduce(llvm::ConstantFP::get(elementType, 1.0), vector);
+        }
+        if (callee == "min") {
+            return m_Builder->CreateFPMinReduce(vector);
+        }
+        return m_Builder->CreateFPMaxReduce(vector);
+    }
+
+    if (callee == "sum") {
+        return m_Builder->CreateAddReduce(vector);
+    }
+    if (callee == "product") {
+        return m_Builder->CreateMulReduce(vector);
+    }
+    if (callee == "min") {
+        return m_Builder->CreateIntMinReduce(vector, true);
+    }
+    return m_Builder->CreateIntMaxReduce(vector, true);
+}
+
+/******************** Statements ********************************************/
+
+llvm::AllocaInst *IRGenerator::createEntryBlockAlloca(llvm::Function *function, const std::string &name, llvm::Type *type) {
+    llvm::IRBuilder<> entryBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+
+    return entryBuilder.CreateAlloca(type, nullptr, name);
+}
+
+bool IRGenerator::generateStatement(std::shared_ptr<ExprAST> statement) {
+    emitLocation(statement.get());
+
+    if (auto definition = std::dynamic_pointer_cast<VariableDefinitionAST>(statement)) {
+        llvm::Value *value = generateTopLevel(definition->getValue());
+
+        if (!value) {
+            return false;
+        }
+
+        generateLocal(definition->getName(), value);
+        return true;
+    }
+
+    if (auto assignment = std::dynamic_pointer_cast<AssignExprAST>(statement)) {
+        llvm::Value *variable = getVariable(assignment->getName());
+
+        if (!variable) {
+            Logger::stream() << "Unknown variable: " << assignment->getName() << std::endl;
+            return false;
+        }
+
+        llvm::Value *value = generateTopLevel(assignment->getValue());
+
+        if (!value) {
+            return false;
+        }
+
+        m_Builder->CreateStore(value, variable);
+        return true;
+    }
+
+    if (auto loop = std::dynamic_pointer_cast<ForExprAST>(statement)) {
+        if (!generateStatement(loop->getInit())) {
+            return false;
+        }
+
+        return generateLoop(loop->getCondition(), loop->getBody(), loop->getStep());
+    }
+
+    if (auto loop = std::dynamic_pointer_cast<WhileExprAST>(statement)) {
+        return generateLoop(loop->getCondition(), loop->getBody(), nullptr);
+    }
+
+    if (auto loop = std::dynamic_pointer_cast<ParallelForExprAST>(statement)) {
+        return generateParallelFor(loop);
+    }
+
+    if (auto ifExpr = std::dynamic_pointer_cast<IfExprAST>(statement)) {
+        return generateIf(ifExpr);
+    }
+
+    if (auto returnExpr = std::dynamic_pointer_cast<ReturnExprAST>(statement)) {
+        if (!generateReturn(returnExpr->getValue())) {
+            return false;
+        }
+
+        // Statements following a return are unreachable, simplifycfg removes them.
+        m_Builder->SetInsertPoint(llvm::BasicBlock::Create(m_Context, "return.after",
+                                                           m_Builder->GetInsertBlock()->getParent()));
+        return true;
+    }
+
+    if (std::dynamic_pointer_cast<PrototypeAST>(statement) ||
+            std::dynamic_pointer_cast<FunctionDefinitionAST>(statement)) {
+        Logger::stream() << "Functions cannot be declared in a function body" << std::endl;
+        return false;
+    }
+
+    // Declared without a value, zero initialized.
+    if (auto declaration = std::dynamic_pointer_cast<DeclarationAST>(statement)) {
+        llvm::Type *type = getLLVMType(declaration->getType());
+
+        if (!type) {
+            Logger::stream() << "Unknown variable type: " << declaration->getType() << std::endl;
+            return false;
+        }
+
+        generateLocal(declaration->getName(), llvm::Constant::getNullValue(type));
+        return true;
+    }
+
+    return generateTopLevel(std::move(statement)) != nullptr;
+}
+
+void IRGenerator::generateLocal(const std::string &name, llvm::Value *value) {
+    llvm::AllocaInst *alloca = createEntryBlockAlloca(m_Builder->GetInsertBlock()->getParent(), name, value->getType());
+    m_Builder->CreateStore(value, alloca);
+
+    m_NamedValues[name] = alloca;
+    NumNamedValuesPeak.updateMax(m_NamedValues.size());
+}
+
+// Address of a local variable, or else of a global, declared in the current
+// module on its first use there.
+llvm::Value *IRGenerator::getVariable(const std::string &name) {
+    auto local = m_NamedValues.find(name);
+
+    if (local != m_NamedValues.end()) {
+        return local->second;
+    }
+
+    auto global = m_Globals.find(name);
+
+    if (global == m_Globals.end()) {
+        return nullptr;
+    }
+
+    if (auto *variable = m_Module->getGlobalVariable(name)) {
+        return variable;
+    }
+
+    return new llvm::GlobalVariable(*m_Module, getLLVMType(global->second), false,
+                                    llvm::GlobalValue::ExternalLinkage, nullptr, name);
+}
+
+// Scalar condition converted to i1.
+llvm::Value *IRGenerator::generateCondition(const std::shared_ptr<ExprAST> &condition) {
+    llvm::Value *value = generateTopLevel(condition);
+
+    if (!value) {
+        return nullptr;
+    }
+
+    if (value->getType()->isFloatingPointTy()) {
+        return m_Builder->CreateFCmpONE(value, llvm::ConstantFP::get(value->getType(), 0.0), "cond");
+    }
+
+    return m_Builder->CreateICmpNE(value, llvm::ConstantInt::get(value->getType(), 0), "cond");
+}
+
+// The condition is tested in the loop header, which the body branches back
+// to. Loop rotation then gives the guarded do-while form the vectorizers
+// expect.
+bool IRGenerator::generateLoop(const std::shared_ptr<ExprAST> &condition,
+                               const std::vector<std::shared_ptr<ExprAST>> &body,
+                               const std::shared_ptr<ExprAST> &step) {
+    llvm::Function *function = m_Builder->GetInsertBlock()->getParent();
+
+    llvm::BasicBlock *headerBlock = llvm::BasicBlock::Create(m_Context, "loop.header", function);
+    llvm::BasicBlock *bodyBlock = llvm::BasicBlock::Create(m_Context, "loop.body", function);
+    llvm::BasicBlock *exitBlock = llvm::BasicBlock::Create(m_Context, "loop.exit", function);
+
+    m_Builder->CreateBr(headerBlock);
+    m_Builder->SetInsertPoint(headerBlock);
+
+    llvm::Value *conditionValue = generateCondition(condition);
+
+    if (!conditionValue) {
+        return false;
+    }
+
+    m_Builder->CreateCondBr(conditionValue, bodyBlock, exitBlock);
+    m_Builder->SetInsertPoint(bodyBlock);
+
+    // The body may not run at all.
+    bool alwaysRuns = m_AlwaysRuns;
+    m_AlwaysRuns = false;
+
+    for (const auto &statement : body) {
+        if (!generateStatement(statement)) {
+            return false;
+        }
+    }
+
+    if (step && !generateStatement(step)) {
+        return false;
+    }
+
+    m_Builder->CreateBr(headerBlock);
+    m_Builder->SetInsertPoint(exitBlock);
+
+    m_AlwaysRuns = alwaysRuns && !containsReturn(body);
+
+    return true;
+}
+
+namespace {
+
+// Variables read, assigned and defined by the body of a parallel loop.
+struct LoopUses {
+    std::map<std::string, int> reads;
+    std::map<std::string, int> assignments;
+    std::set<std::string> defined;
+    std::vector<std::shared_ptr<AssignExprAST>> assigns;
+    bool hasReturn = false;
+
+    void collect(const std::vector<std::shared_ptr<ExprAST>> &body) {
+        forEachExpr(body, [this](const std::shared_ptr<ExprAST> &expr) {
+            if (auto variable = std::dynamic_pointer_cast<VariableExprAST>(expr)) {
+                reads[variable->getIdentifier()]++;
+            } else if (auto assign = std::dynamic_pointer_cast<AssignExprAST>(expr)) {
+                assignments[assign->getName()]++;
+                assigns.push_back(assign);
+            } else if (auto declaration = std::dynamic_pointer_cast<DeclarationAST>(expr)) {
+                defined.insert(declaration->getName());
+            } else if (auto loop = std::dynamic_pointer_cast<ParallelForExprAST>(expr)) {
+                defined.insert(loop->getVariable());
+            } else if (std::dynamic_pointer_cast<ReturnExprAST>(expr)) {
+                hasReturn = true;
+            }
+        });
+    }
+
+    // Every assignment of the variable is `name = name + e` or `name = e + name`,
+    // where e does not read it.
+    bool isSumReduction(const std::string &name) const {
+        for (const auto &assign : assigns) {
+            if (assign->getName() != name) {
+                continue;
+            }
+
+            auto sum = std::dynamic_pointer_cast<BinaryOpExprAST>(assign->getValue());
+
+            auto isVariable = [&](const std::shared_ptr<ExprAST> &expr) {
+                auto variable = std::dynamic_pointer_cast<VariableExprAST>(expr);
+                return variable && variable->getIdentifier() == name;
+            };
+
+            if (!sum || sum->getOp() != '+' || !(isVariable(sum->getLHS()) || isVariable(sum->getRHS()))) {
+                return false;
+            }
+        }
+
+        return reads.at(name) == assignments.at(name);
+    }
+};
+
+}
+
+// The body is outlined into `void fn.parallel(i8 *context, i64 begin, i64 end)`
+// running the iterations [begin, end), handed to the runtime with a context
+// of pointers to the caller's variables it uses. Those are only read, except
+// for sums: each task accumulates a private copy, added atomically to the
+// caller's variable once its iterations are done.
+bool IRGenerator::generateParallelFor(const std::shared_ptr<ParallelForExprAST> &loop) {
+    LoopUses uses;
+    uses.collect(loop->getBody());
+
+    if (uses.hasReturn) {
+        Logger::stream() << "A parallel for cannot return, line: " << loop->getLine() << std::endl;
+        return false;
+    }
+
+    if (uses.assignments.count(loop->getVariable())) {
+        Logger::stream() << "The variable of a parallel for cannot be assigned in its body: "
+            << loop->getVariable() << std::endl;
+        return false;
+    }
+
+    llvm::Value *begin = generateTopLevel(loop->getBegin());
+    llvm::Value *end = begin ? generateTopLevel(loop->getEnd()) : nullptr;
+
+    if (!end) {
+        return false;
+    }
+
+    llvm::Type *indexType = m_Builder->getInt64Ty();
+    begin = m_Builder->CreateSExtOrTrunc(begin, indexType);
+    end = m_Builder->CreateSExtOrTrunc(end, indexType);
+
+    std::vector<std::string> captures;
+    std::set<std::string> reductions;
+
+    for (const auto &variable : m_NamedValues) {
+        const std::string &name = variable.first;
+
+        if (name == loop->getVariable() || uses.defined.count(name)) {
+            continue;
+        }
+
+        if (uses.assignments.count(name)) {
+            llvm::Type *type = variable.second->getAllocatedType();
+
+            if (!type->isIntegerTy() && !type->isFloatTy() && !type->isDoubleTy()) {
+                Logger::stream() << "Only scalars can be summed in a parallel for: " << name << std::endl;
+                return false;
+            }
+
+            if (!uses.isSumReduction(name)) {
+                Logger::stream() << "A variable declared outside of a parallel for can only be summed in it, "
+                    << "as in " << name << " = " << name << " + ...;" << std::endl;
+                return false;
+            }
+
+            reductions.insert(name);
+        } else if (!uses.reads.count(name)) {
+            continue;
+        }
+
+        captures.push_back(name);
+    }
+
+    for (const auto &assignment : uses.assignments) {
+        const std::string &name = assignment.first;
+
+        if (!m_NamedValues.count(name) && !uses.defined.count(name) && m_Globals.count(name)) {
+            Logger::stream() << "A global variable cannot be assigned in a parallel for: " << name << std::endl;
+            return false;
+        }
+    }
+
+    llvm::Function *caller = m_Builder->GetInsertBlock()->getParent();
+
+    std::vector<llvm::Type *> fieldTypes;
+    for (const auto &name : captures) {
+        fieldTypes.push_back(m_NamedValues[name]->getType());
+    }
+    llvm::StructType *contextType = llvm::StructType::get(m_Context, fieldTypes);
+
+    llvm::Type *voidPtrType = m_Builder->getInt8PtrTy();
+    llvm::FunctionType *taskType = llvm::FunctionType::get(m_Builder->getVoidTy(),
+                                                           {voidPtrType, indexType, indexType}, false);
+    llvm::Function *task = llvm::Function::Create(taskType, llvm::Function::InternalLinkage,
+                                                  caller->getName() + ".parallel", m_Module.get());
+
+    // Filled in the caller.
+    llvm::AllocaInst *context = createEntryBlockAlloca(caller, "parallel.context", contextType);
+    for (unsigned i = 0; i < captures.size(); i++) {
+        m_Builder->CreateStore(m_NamedValues[captures[i]], m_Builder->CreateStructGEP(contextType, context, i));
+    }
+
+    auto callerBlock = m_Builder->GetInsertBlock();
+    auto callerValues = m_NamedValues;
+    auto callerSubprogram = m_DISubprogram;
+    auto callerLocation = m_Builder->getCurrentDebugLocation();
+
+    m_DISubprogram = nullptr;
+    m_Builder->SetCurrentDebugLocation(llvm::DebugLoc());
+
+    // The outlined body, run by the worker threads.
+    auto taskArg = task->arg_begin();
+    llvm::Value *taskContext = &*taskArg++;
+    llvm::Value *taskBegin = &*taskArg++;
+    llvm::Value *taskEnd = &*taskArg;
+
+    // Nested loops are outlined from the task of the enclosing one, named after the function.
+    auto callerProto = m_FunctionDefs.find(caller->getName().split('.').first.str());
+
+    m_Builder->SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", task));
+    if (callerProto != m_FunctionDefs.end()) {
+        setFPMode(*callerProto->second, task);
+    }
+
+    llvm::Value *fields = m_Builder->CreateBitCast(taskContext, contextType->getPointerTo());
+    std::vector<llvm::Value *> shared;
+    m_NamedValues.clear();
+
+    for (unsigned i = 0; i < captures.size(); i++) {
+        llvm::Value *pointer = m_Builder->CreateLoad(fieldTypes[i], m_Builder->CreateStructGEP(contextType, fields, i));
+        llvm::Type *type = callerValues[captures[i]]->getAllocatedType();
+
+        shared.push_back(pointer);
+        if (reductions.count(captures[i])) {
+            generateLocal(captures[i], llvm::Constant::getNullValue(type));
+        } else {
+            generateLocal(captures[i], m_Builder->CreateLoad(type, pointer, captures[i]));
+        }
+    }
+
+    llvm::Type *variableType = getLLVMType(loop->getVariableType());
+    llvm::AllocaInst *index = createEntryBlockAlloca(task, "parallel.index", indexType);
+    m_Builder->CreateStore(taskBegin, index);
+    generateLocal(loop->getVariable(), llvm::Constant::getNullValue(variableType));
+
+    llvm::BasicBlock *headerBlock = llvm::BasicBlock::Create(m_Context, "loop.header", task);
+    llvm::BasicBlock *bodyBlock = llvm::BasicBlock::Create(m_Context, "loop.body", task);
+    llvm::BasicBlock *exitBlock = llvm::BasicBlock::Create(m_Context, "loop.exit", task);
+
+    m_Builder->CreateBr(headerBlock);
+    m_Builder->SetInsertPoint(headerBlock);
+
+    llvm::Value *indexValue = m_Builder->CreateLoad(indexType, index);
+    m_Builder->CreateCondBr(m_Builder->CreateICmpSLT(indexValue, taskEnd), bodyBlock, exitBlock);
+
+    m_Builder->SetInsertPoint(bodyBlock);
+    m_Builder->CreateStore(m_Builder->CreateTrunc(indexValue, variableType), m_NamedValues[loop->getVariable()]);
+
+    // The loop may have no iteration, it cannot return.
+    bool alwaysRuns = m_AlwaysRuns;
+    m_AlwaysRuns = false;
+
+    bool isBodyValid = true;
+    for (const auto &statement : loop->getBody()) {
+        if (!generateStatement(statement)) {
+            isBodyValid = false;
+            break;
+        }
+    }
+
+    m_AlwaysRuns = alwaysRuns;
+
+    if (isBodyValid) {
+        m_Builder->CreateStore(m_Builder->CreateAdd(indexValue, llvm::ConstantInt::get(indexType, 1)), index);
+        m_Builder->CreateBr(headerBlock);
+        m_Builder->SetInsertPoint(exitBlock);
+
+        for (unsigned i = 0; i < captures.size(); i++) {
+            if (!reductions.count(captures[i])) {
+                continue;
+            }
+
+            llvm::AllocaInst *privateSum = m_NamedValues[captures[i]];
+            llvm::Value *sum = m_Builder->CreateLoad(privateSum->getAllocatedType(), privateSum);
+            m_Builder->CreateAtomicRMW(sum->getType()->isFloatingPointTy() ? llvm::AtomicRMWInst::FAdd : llvm::AtomicRMWInst::Add,
+                                       shared[i], sum, llvm::AtomicOrdering::Monotonic);
+        }
+
+        m_Builder->CreateRetVoid();
+        llvm::verifyFunction(*task);
+
+        TimeReport::Scope timer(Phase::Optimize);
+        m_PassManager->run(*task);
+    }
+
+    m_NamedValues = std::move(callerValues);
+    m_DISubprogram = callerSubprogram;
+    m_Builder->SetInsertPoint(callerBlock);
+    m_Builder->SetCurrentDebugLocation(callerLocation);
+
+    if (callerProto != m_FunctionDefs.end()) {
+        setFPMode(*callerProto->second, caller);
+    }
+
+    if (!isBodyValid) {
+        task->eraseFromParent();
+        return false;
+    }
+
+    llvm::FunctionCallee parallelFor = m_Module->getOrInsertFunction(
+            "yapl_parallel_for", m_Builder->getVoidTy(), indexType, indexType, task->getType(), voidPtrType);
+    m_Builder->CreateCall(parallelFor, {begin, end, task, m_Builder->CreateBitCast(context, voidPtrType)});
+
+    ++NumParallelLoops;
+
+    return true;
+}
+
+bool IRGenerator::generateIf(const std::shared_ptr<IfExprAST> &ifExpr) {
+    llvm::Value *conditionValue = generateCondition(ifExpr->getCondition());
+
+    if (!conditionValue) {
+        return false;
+    }
+
+    llvm::Function *function = m_Builder->GetInsertBlock()->getParent();
+
+    llvm::BasicBlock *thenBlock = llvm::BasicBlock::Create(m_Context, "if.then", function);
+    llvm::BasicBlock *endBlock = llvm::BasicBlock::Create(m_Context, "if.end", function);
+    llvm::BasicBlock *elseBlock = ifExpr->getElse().empty() ?
+        endBlock :
+        llvm::BasicBlock::Create(m_Context, "if.else", function, endBlock);
+
+    m_Builder->CreateCondBr(conditionValue, thenBlock, elseBlock);
+
+    bool alwaysRuns = m_AlwaysRuns;
+    m_AlwaysRuns = false;
+
+    m_Builder->SetInsertPoint(thenBlock);
+
+    for (const auto &statement : ifExpr->getThen()) {
+        if (!generateStatement(statement)) {
+            return false;
+        }
+    }
+
+    m_Builder->CreateBr(endBlock);
+
+    if (elseBlock != endBlock) {
+        m_Builder->SetInsertPoint(elseBlock);
+
+        for (const auto &statement : ifExpr->getElse()) {
+            if (!generateStatement(statement)) {
+                return false;
+            }
+        }
+
+        m_Builder->CreateBr(endBlock);
+    }
+
+    // Past a branch returning, the rest of the function may not run.
+    m_AlwaysRuns = alwaysRuns && !containsReturn(ifExpr->getThen()) && !containsReturn(ifExpr->getElse());
+
+    m_Builder->SetInsertPoint(endBlock);
+
+    return true;
+}
+
+// Each operand of a returned conditional is returned from its own branch, so
+// that a self-recursive call in either is directly followed by the ret and can
+// be marked musttail. The backend then reuses the caller's frame and
+// TailCallElim turns the recursion into a loop: deep recursion runs in
+// constant stack.
+bool IRGenerator::generateReturn(const std::shared_ptr<ExprAST> &value) {
+    if (!value) {
+        Logger::stream() << "Expected a return at the end of the function" << std::endl;
+        return false;
+    }
+
+    llvm::Function *function = m_Builder->GetInsertBlock()->getParent();
+
+    if (auto conditional = std::dynamic_pointer_cast<ConditionalExprAST>(value)) {
+        llvm::Value *conditionValue = generateCondition(conditional->getCondition());
+
+        if (!conditionValue) {
+            return false;
+        }
+
+        llvm::BasicBlock *thenBlock = llvm::BasicBlock::Create(m_Context, "return.then", function);
+        llvm::BasicBlock *elseBlock = llvm::BasicBlock::Create(m_Context, "return.else", function);
+
+        m_Builder->CreateCondBr(conditionValue, thenBlock, elseBlock);
+
+        bool alwaysRuns = m_AlwaysRuns;
+        m_AlwaysRuns = false;
+
+        m_Builder->SetInsertPoint(thenBlock);
+
+        if (!generateReturn(conditional->getThen())) {
+            return false;
+        }
+
+        m_Builder->SetInsertPoint(elseBlock);
+
+        bool isValid = generateReturn(conditional->getElse());
+        m_AlwaysRuns = alwaysRuns;
+
+        return isValid;
+    }
+
+    llvm::Value *retValue = generateTopLevel(value);
+
+    if (!retValue) {
+        return false;
+    }
+
+    if (auto *call = llvm::dyn_cast<llvm::CallInst>(retValue)) {
+        // Arguments are passed by value, no callee can reach the caller's allocas.
+        if (call->getCalledFunction() == function) {
+            call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+            ++NumMustTailCalls;
+        } else {
+            call->setTailCall();
+        }
+    }
+
+    if (retValue->getType() != function->getReturnType())
+        retValue->mutateType(function->getReturnType());
+
+    m_Builder->CreateRet(retValue);
+
+    return true;
+}
+
+/******************** DeclarationAST ********************************************/
+
+
+llvm::Function *IRGenerator::generateDeclaration(std::shared_ptr<DeclarationAST> parsedDeclaration) {
+
+    if (auto parsedDefinition = std::dynamic_pointer_cast<FunctionDefinitionAST>(parsedDeclaration)) {
+        return generateFunctionVersion(std::move(parsedDefinition));
+    }
+
+    if (auto parsedProto = std::dynamic_pointer_cast<PrototypeAST>(parsedDeclaration)) {
+        // Declared in later modules too, resolved in the process if not defined.
+        m_FunctionDefs[parsedProto->getName()] = parsedProto;
+        NumFunctionDefs.set(m_FunctionDefs.size());
+
+        return generatePrototype(std::move(parsedProto));
+    }
+
+    return nullptr;
+}
+
+/*
+ * Defines a top level variable as a global of the current module, zero
+ * initialized, declared in the later modules using it. A literal value is
+ * its initializer, any other value is stored by `void name.init()`, run once
+ * the module is added. Defining the variable again with the same type only
+ * stores its new value.
+ */
+bool IRGenerator::generateGlobal(std::shared_ptr<DeclarationAST> parsedDeclaration) {
+    const std::string &name = parsedDeclaration->getName();
+    const std::string &typeName = parsedDeclaration->getType();
+    llvm::Type *type = getLLVMType(typeName);
+
+    if (!type) {
+        Logger::stream() << "Unknown variable type: " << typeName << std::endl;
+        return false;
+    }
+
+    auto previous = m_Globals.find(name);
+
+    if (previous != m_Globals.end() && previous->second != typeName) {
+        Logger::stream() << "Cannot redefine " << name << " of type " << previous->second << " as " << typeName
+            << std::endl;
+        m_Parser.declareVariable(name, previous->second);
+        return false;
+    }
+
+    auto definition = std::dynamic_pointer_cast<VariableDefinitionAST>(parsedDeclaration);
+    std::shared_ptr<ExprAST> value = definition ? definition->getValue() : nullptr;
+
+    if (previous == m_Globals.end()) {
+        llvm::Constant *initializer = llvm::Constant::getNullValue(type);
+
+        if (auto literal = std::dynamic_pointer_cast<NumberExprAST>(value)) {
+            initializer = llvm::cast<llvm::Constant>(generateTopLevel(literal));
+            value = nullptr;
+        }
+
+        new llvm::GlobalVariable(*m_Module, type, false, llvm::GlobalValue::ExternalLinkage, initializer, name);
+        m_Globals[name] = typeName;
+        ++NumGlobals;
+    }
+
+    if (!value) {
+        return true;
+    }
+
+    std::string initializerName = initializerFunctionName(name);
+    std::string symbol = versionedFunctionName(initializerName, ++m_InitializerVersions[name]);
+    llvm::Function *initializer = llvm::Function::Create(llvm::FunctionType::get(m_Builder->getVoidTy(), false),
+                                                         llvm::Function::ExternalLinkage, symbol, m_Module.get());
+
+    m_Builder->SetInsertPoint(llvm::BasicBlock::Create(m_Context, "entry", initializer));
+    m_AlwaysRuns = true;
+    setFPMode(PrototypeAST(std::make_shared<DeclarationAST>(typeName, symbol), {}), initializer);
+    m_NamedValues.clear();
+
+    if (!generateStatement(std::make_shared<AssignExprAST>(name, value))) {
+        initializer->eraseFromParent();
+        return false;
+    }
+
+    m_Builder->CreateRetVoid();
+    llvm::verifyFunction(*initializer);
+
+    {
+        TimeReport::Scope timer(Phase::Optimize);
+        m_PassManager->run(*initializer);
+    }
+
+    m_PendingInitializers.push_back(symbol);
+    return true;
+}
+
+llvm::Function *IRGenerator::generatePrototype(std::shared_ptr<PrototypeAST> parsedPrototype) {
+    auto params = parsedPrototype->getParams();
+    std::vector<llvm::Type *> paramTypes;
+
+    for (const auto &param : params) {
+        if (llvm::Type *paramType = getLLVMType(param->getType())) {
+            paramTypes.push_back(paramType);
+        } else {
+            Logger::stream() << "Unknown param type: " << param->getType() << " param ignored!" << std::endl;
+        }
+    }
+
+    llvm::Type *returnType = getLLVMType(parsedPrototype->getType());
+
+    if (!returnType) {
+        Logger::stream() << "Unknown function type: " << parsedPrototype->getType() << " function ignored!"
+            << std::endl;
+        return nullptr;
+    }
+
+    llvm::FunctionType *functionType = llvm::FunctionType::get(returnType, paramTypes, false);
+
+    llvm::Function *function = llvm::Function::Create(
+            functionType,
+            llvm::Function::ExternalLinkage,
+            parsedPrototype->getName(),
+            m_Module.get());
+
+    unsigned idx = 0;
+    for (auto &arg : function->args()) {
+        arg.setName(params[idx++]->getName());
+    }
+
+    return function;
+}
+
+// Every definition of a function is compiled to a new symbol, name.N, and
+// the stub named after the function is pointed to it. Other functions call
+// the stub: redefining a function only compiles its new body, and the batch
+// wrappers it was inlined in once the module is added to the JIT.
+llvm::Function *IRGenerator::generateFunctionVersion(std::shared_ptr<FunctionDefinitionAST> parsedFunctionDefinition) {
+    const std::string name = parsedFunctionDefinition->getName();
+    std::shared_ptr<PrototypeAST> previousProto = getPrototype(name);
+
+    // Callers were compiled against the previous signature.
+    if (previousProto && !hasSameSignature(*previousProto, *parsedFunctionDefinition->getPrototype())) {
+        auto callers = getCallers(name);
+
+        if (!callers.empty()) {
+            Logger::stream() << "Cannot change the signature of " << name << ", called by:";
+            for (const auto &caller : callers) {
+                Logger::stream() << " " << caller;
+            }
+            Logger::stream() << std::endl;
+
+            m_Parser.declare(*previousProto);
+            return nullptr;
+        }
+    }
+
+    // A memoized result must only depend on the arguments.
+    if (parsedFunctionDefinition->getPrototype()->hasAttribute("pure")) {
+        std::string global = findGlobalUse(*parsedFunctionDefinition, m_Globals);
+
+        if (!global.empty()) {
+            Logger::stream() << "The pure function " << name << " cannot use the global variable " << global
+                << std::endl;
+
+            if (previousProto) {
+                m_Parser.declare(*previousProto);
+            }
+
+            return nullptr;
+        }
+    }
+
+    m_FoldedCallees.clear();
+
+    // Set first, recursive calls go to the version being generated.
+    int previousVersion = m_Versions[name];
+    m_Versions[name] = previousVersion + 1;
+
+    llvm::Function *function = generateFunctionDefinition(parsedFunctionDefinition,
+                                                          versionedFunctionName(name, previousVersion + 1));
+
+    if (!function) {
+        if (previousVersion == 0) {
+            m_Versions.erase(name);
+        } else {
+            m_Versions[name] = previousVersion;
+        }
+
+        if (previousProto) {
+            m_FunctionDefs[name] = previousProto;
+            m_Parser.declare(*previousProto);
+        }
+
+        return nullptr;
+    }
+
+    if (parsedFunctionDefinition->getPrototype()->hasAttribute("pure") && m_Options.memoSize != 0) {
+        function = generateMemoized(function, name);
+    } else {
+        m_Memoized.erase(name);
+    }
+
+    m_Callees[name] = collectCallees(parsedFunctionDefinition);
+    m_FunctionBodies[name] = std::move(parsedFunctionDefinition);
+
+    if (m_FoldedCallees.empty()) {
+        m_FoldDependencies.erase(name);
+    } else {
+        m_FoldDependencies[name] = std::move(m_FoldedCallees);
+        m_FoldedCallees.clear();
+    }
+
+    if (previousVersion != 0) {
+        ++NumRedefinitions;
+        clearMemoizedCallers(name);
+
+        // The functions folding calls to it hold results of the previous definition.
+        m_FoldedCalls.clear();
+        for (const auto &dependency : m_FoldDependencies) {
+            if (dependency.first != name && dependency.second.count(name)) {
+                m_StaleFolds.insert(dependency.first);
+            }
+        }
+
+        for (const auto &batch : m_BatchInlines) {
+            if (batch.second.count(name)) {
+                m_StaleBatches.insert(batch.first);
+            }
+        }
+    }
+
+    if (auto err = m_YAPLJIT->defineStub(name, function->getName().str())) {
+        llvm::logAllUnhandledErrors(std::move(err), Logger::llvmStream(), "Failed to define " + name + ": ");
+    } else if (hasVectorParameter(function) || m_YAPLJIT->isConcurrent()) {
+        m_EagerStubs.insert(name);
+    }
+
+    return function;
+}
+
+/*
+ * Memoizes a pure function: its definition becomes the internal body of a
+ * function of the same symbol looking the arguments up in a direct mapped
+ * table before calling it, recursive calls included. Each entry is
+ * { i64 sequence, [n x i64] arguments, i64 result }, arguments and result
+ * widened to 64 bits. The sequence is odd while the entry is written, a
+ * lookup racing with a write of the same entry, from a parallel loop, sees
+ * it change and calls the body.
+ */
+llvm::Function *IRGenerator::generateMemoized(llvm::Function *body, const std::string &name) {
+    llvm::FunctionType *type = body->getFunctionType();
+
+    auto isScalar = [](llvm::Type *scalarType) {
+        return scalarType->isIntegerTy() || scalarType->isFloatTy() || scalarType->isDoubleTy();
+    };
+
+    if (!isScalar(type->getReturnType()) || !std::all_of(type->param_begin(), type->param_end(), isScalar)) {
+        Logger::stream() << "Only functions of scalars are memoized, pure ignored for " << name << std::endl;
+        m_Memoized.erase(name);
+        return body;
+    }
+
+    std::string symbol = body->getName().str();
+    body->setName(symbol + ".body");
+    body->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+    llvm::Function *function = llvm::Function::Create(type, llvm::Function::ExternalLinkage, symbol, m_Module.get());
+    body->replaceAllUsesWith(function);
+
+    llvm::Type *wordType = m_Builder->getInt64Ty();
+    uint64_t size = llvm::PowerOf2Ceil(std::max(m_Options.memoSize, 2u));
+
+    llvm::StructType *entryType = llvm::StructType::get(
+            m_Context, { wordType, llvm::ArrayType::get(wordType, type->getNumParams()), wordType });
+    llvm::ArrayType *tableType = llvm::ArrayType::get(entryType, size);
+    llvm::ArrayType *statsType = llvm::ArrayType::get(wordType, 2);
+
+    auto *table = new llvm::GlobalVariable(*m_Module, tableType, false, llvm::GlobalValue::ExternalLinkage,
+                                           llvm::ConstantAggregateZero::get(tableType), memoTableName(symbol));
+    // Shared by every thread calling the function, only counted for --stats.
+    llvm::GlobalVariable *stats = nullptr;
+
+    if (m_Options.statistics) {
+        stats = new llvm::GlobalVariable(*m_Module, statsType, false, llvm::GlobalValue::ExternalLinkage,
+                                         llvm::ConstantAggregateZero::get(statsType), memoStatsName(symbol));
+    }
+
+    auto toWord = [&](llvm::Value *value) -> llvm::Value * {
+        if (value->getType()->isFloatTy()) {
+            return m_Builder->CreateZExt(m_Builder->CreateBitCast(value, m_Builder->getInt32Ty()), wordType);
+        }
+        if (value->getType()->isDoubleTy()) {
+            return m_Builder->CreateBitCast(value, wordType);
+        }
+        return m_Builder->CreateSExt(value, wordType);
+    };
+
+    auto fromWord = [&](llvm::Value *word, llvm::Type *valueType) -> llvm::Value * {
+        if (valueType->isFloatTy()) {
+            return m_Builder->CreateBitCast(m_Builder->CreateTrunc(word, m_Builder->getInt32Ty()), valueType);
+        }
+        if (valueType->isDoubleTy()) {
+            return m_Builder->CreateBitCast(word, valueType);
+        }
+        return m_Builder->CreateTrunc(word, valueType);
+    };
+
+    auto load = [&](llvm::Value *address, llvm::AtomicOrdering ordering) {
+        llvm::LoadInst *value = m_Builder->CreateAlignedLoad(wordType, address, llvm::MaybeAlign(8));
+        value->setAtomic(ordering);
+        return value;
+    };
+
+    auto store = [&](llvm::Value *value, llvm::Value *address, llvm::AtomicOrdering ordering) {
+        m_Builder->CreateAlignedStore(value, address, llvm::MaybeAlign(8))->setAtomic(ordering);
+    };
+
+    auto count = [&](unsigned counter) {
+        if (!stats) {
+            return;
+        }
+
+        llvm::Value *address = m_Builder->CreateConstInBoundsGEP2_32(statsType, stats, 0, counter);
+        m_Builder->CreateAtomicRMW(llvm::AtomicRMWInst::Add, address,
+                                   m_Builder->getInt64(1), llvm::AtomicOrdering::Monotonic);
+    };
+
+    auto keyAddress = [&](llvm::Value *entry, unsigned i) {
+        return m_Builder->CreateInBoundsGEP(entryType, entry,
+                                            { m_Builder->getInt64(0), m_Builder->getInt32(1), m_Builder->getInt64(i) });
+    };
+
+    llvm::BasicBlock *entryBlock = llvm::BasicBlock::Create(m_Context, "entry", function);
+    llvm::BasicBlock *compareBlock = llvm::BasicBlock::Create(m_Context, "memo.compare", function);
+    llvm::BasicBlock *hitBlock = llvm::BasicBlock::Create(m_Context, "memo.hit", function);
+    llvm::BasicBlock *missBlock = llvm::BasicBlock::Create(m_Context, "memo.miss", function);
+    llvm::BasicBlock *lockBlock = llvm::BasicBlock::Create(m_Context, "memo.lock", function);
+    llvm::BasicBlock *writeBlock = llvm::BasicBlock::Create(m_Context, "memo.write", function);
+    llvm::BasicBlock *returnBlock = llvm::BasicBlock::Create(m_Context, "memo.return", function);
+
+    m_Builder->SetInsertPoint(entryBlock);
+
+    // Fibonacci hashing: the high bits of the product index the table.
+    std::vector<llvm::Value *> arguments;
+    std::vector<llvm::Value *> keys;
+    llvm::Value *hash = m_Builder->getInt64(0);
+
+    for (auto &arg : function->args()) {
+        arguments.push_back(&arg);
+        keys.push_back(toWord(&arg));
+        hash = m_Builder->CreateMul(m_Builder->CreateXor(hash, keys.back()),
+                                    m_Builder->getInt64(0x9E3779B97F4A7C15));
+    }
+
+    llvm::Value *index = m_Builder->CreateLShr(hash, 64 - llvm::Log2_64(size));
+    llvm::Value *entry = m_Builder->CreateInBoundsGEP(tableType, table, { m_Builder->getInt64(0), index });
+    llvm::Value *sequenceAddress = m_Builder->CreateStructGEP(entryType, entry, 0);
+
+    llvm::Value *sequence = load(sequenceAddress, llvm::AtomicOrdering::Acquire);
+    llvm::Value *isWritten = m_Builder->CreateAnd(
+            m_Builder->CreateICmpNE(sequence, m_Builder->getInt64(0)),
+            m_Builder->CreateICmpEQ(m_Builder->CreateAnd(sequence, 1), m_Builder->getInt64(0)));
+    m_Builder->CreateCondBr(isWritten, compareBlock, missBlock);
+
+    m_Builder->SetInsertPoint(compareBlock);
+    llvm::Value *isHit = m_Builder->getTrue();
+
+    for (unsigned i = 0; i < keys.size(); i++) {
+        llvm::Value *key = load(keyAddress(entry, i), llvm::AtomicOrdering::Monotonic);
+        isHit = m_Builder->CreateAnd(isHit, m_Builder->CreateICmpEQ(key, keys[i]));
+    }
+
+    llvm::Value *cached = load(m_Builder->CreateStructGEP(entryType, entry, 2), llvm::AtomicOrdering::Monotonic);
+    m_Builder->CreateFence(llvm::AtomicOrdering::Acquire);
+    llvm::Value *sequenceAfter = load(sequenceAddress, llvm::AtomicOrdering::Monotonic);
+    isHit = m_Builder->CreateAnd(isHit, m_Builder->CreateICmpEQ(sequenceAfter, sequence));
+    m_Builder->CreateCondBr(isHit, hitBlock, missBlock);
+
+    m_Builder->SetInsertPoint(hitBlock);
+    count(0);
+    m_Builder->CreateRet(fromWord(cached, type->getReturnType()));
+
+    // The entry is written unless another thread is writing it.
+    m_Builder->SetInsertPoint(missBlock);
+    count(1);
+    llvm::Value *result = m_Builder->CreateCall(body, arguments);
+    llvm::Value *current = load(sequenceAddress, llvm::AtomicOrdering::Monotonic);
+    m_Builder->CreateCondBr(m_Builder->CreateICmpEQ(m_Builder->CreateAnd(current, 1), m_Builder->getInt64(0)),
+                            lockBlock, returnBlock);
+
+    m_Builder->SetInsertPoint(lockBlock);
+    llvm::Value *locked = m_Builder->CreateAdd(current, m_Builder->getInt64(1));
+    llvm::Value *exchange = m_Builder->CreateAtomicCmpXchg(sequenceAddress, current, locked,
+                                                           llvm::AtomicOrdering::Acquire,
+                                                           llvm::AtomicOrdering::Monotonic);
+    m_Builder->CreateCondBr(m_Builder->CreateExtractValue(exchange, 1), writeBlock, returnBlock);
+
+    m_Builder->SetInsertPoint(writeBlock);
+    // Orders the stores below after the odd sequence: a lookup reading any of
+    // them then reads a changed sequence.
+    m_Builder->CreateFence(llvm::AtomicOrdering::Release);
+    for (unsigned i = 0; i < keys.size(); i++) {
+        store(keys[i], keyAddress(entry, i), llvm::AtomicOrdering::Monotonic);
+    }
+    store(toWord(result), m_Builder->CreateStructGEP(entryType, entry, 2), llvm::AtomicOrdering::Monotonic);
+    store(m_Builder->CreateAdd(current, m_Builder->getInt64(2)), sequenceAddress, llvm::AtomicOrdering::Release);
+    m_Builder->CreateBr(returnBlock);
+
+    m_Builder->SetInsertPoint(returnBlock);
+    m_Builder->CreateRet(result);
+
+    llvm::verifyFunction(*function);
+
+    {
+        TimeReport::Scope timer(Phase::Optimize);
+        m_PassManager->run(*function);
+    }
+
+    m_Memoized[name] = symbol;
+    ++NumMemoizedFunctions;
+
+    return function;
+}
+
+// Results of the memoized functions calling a redefined one, directly or
+// not, were computed with its previous definition.
+void IRGenerator::clearMemoizedCallers(const std::string &name) {
+    std::set<std::string> callers;
+    std::vector<std::string> worklist = { name };
+
+    while (!worklist.empty()) {
+        std::string callee = std::move(worklist.back());
+        worklist.pop_back();
+
+        for (const auto &caller : getCallers(callee)) {
+            if (callers.insert(caller).second) {
+                worklist.push_back(caller);
+            }
+        }
+    }
+
+    uint64_t size = llvm::PowerOf2Ceil(std::max(m_Options.memoSize, 2u));
+
+    for (const auto &caller : callers) {
+        auto memoized = m_Memoized.find(caller);
+
+        if (memoized == m_Memoized.end()) {
+            continue;
+        }
+
+        auto table = m_YAPLJIT->lookup(memoTableName(memoized->second));
+
+        if (!table) {
+            llvm::logAllUnhandledErrors(table.takeError(), Logger::llvmStream(),
+                                        "Failed to clear the results of " + caller + ": ");
+            continue;
+        }
+
+        uint64_t entrySize = (m_FunctionDefs[caller]->getParams().size() + 2) * sizeof(uint64_t);
+        std::memset(reinterpret_cast<void *>(table->getAddress()), 0, size * entrySize);
+    }
+}
+
+std::vector<std::string> IRGenerator::getCallers(const std::string &name) const {
+    std::vector<std::string> callers;
+
+    for (const auto &function : m_Callees) {
+        if (function.first != name && function.second.count(name)) {
+            callers.push_back(function.first);
+        }
+    }
+
+    return callers;
+}
+
+llvm::Function *IRGenerator::generateFunctionDefinition(std::shared_ptr<FunctionDefinitionAST> parsedFunctionDefinition,
+                                                        const std::string &symbol) {
+    auto &proto = *parsedFunctionDefinition->getPrototype().get();
+    auto p = parsedFunctionDefinition->getPrototype();
+    m_FunctionDefs[p->getName()] = p;
+    NumFunctionDefs.set(m_FunctionDefs.size());
+
+    llvm::Function *function = generatePrototype(std::move(p));
+
+    if (!function) {
+        return nullptr;
+    }
+
+    function->setName(symbol);
+
+    llvm::BasicBlock *basicBlock = llvm::BasicBlock::Create(m_Context, "entry", function);
+    m_Builder->SetInsertPoint(basicBlock);
+    m_AlwaysRuns = true;
+
+    m_DISubprogram = generateDebugSubprogram(proto, function);
+    emitLocation(parsedFunctionDefinition.get());
+
+    setFPMode(proto, function);
+
+    m_NamedValues.clear();
+
+    // Parameters and locals live in allocas, promoted to registers by mem2reg.
+    for (auto &arg : function->args()) {
+        llvm::AllocaInst *alloca = createEntryBlockAlloca(function, arg.getName().str(), arg.getType());
+        m_Builder->CreateStore(&arg, alloca);
+        m_NamedValues[arg.getName().str()] = alloca;
+    }
+    NumNamedValuesPeak.updateMax(m_NamedValues.size());
 
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
+    bool isBodyValid = true;
+    for (const auto &statement : parsedFunctionDefinition->getBlocks()) {
+        if (!generateStatement(statement)) {
+            isBodyValid = false;
+            break;
+        }
+    }
 
-    m_Module = std::make_unique<llvm::Module>("test", m_Context);
-    m_Builder = std::make_unique<llvm::IRBuilder<>>(m_Context);
+    if (isBodyValid && generateReturn(parsedFunctionDefinition->getReturnExpr())) {
+        m_DISubprogram = nullptr;
+        m_Builder->SetCurrentDebugLocation(llvm::DebugLoc());
 
-    if(auto JitOrErr = YAPLJIT::Create()) {
-        m_YAPLJIT = std::move(JitOrErr.get());
-    } else {
-        auto err = JitOrErr.takeError();
-        std::cerr << "Failed to create JIT" << std::endl;
+        llvm::verifyFunction(*function);
 
-        exit(EXIT_FAILURE);
+        {
+            TimeReport::Scope timer(Phase::Optimize);
+            m_PassManager->run(*function);
+        }
+
+        return function;
     }
 
-    m_Module->setDataLayout(m_YAPLJIT->getDataLayout());
+    m_DISubprogram = nullptr;
+    m_Builder->SetCurrentDebugLocation(llvm::DebugLoc());
+
+    function->eraseFromParent();
 
-    m_PassManager = std::make_unique<PassManager>(m_Module.get());
+    return nullptr;
 }
 
-void IRGenerator::generate() {
+// The operations of a function get the fast-math flags of its attribute or
+// else of the command line. The fma contraction itself happens in the
+// backend, for operations flagged contract.
+void IRGenerator::setFPMode(const PrototypeAST &proto, llvm::Function *function) {
+    FPMode mode = m_Options.fpMode;
+
+    if (proto.hasAttribute("strictmath")) {
+        mode = FPMode::Strict;
+    } else if (proto.hasAttribute("fpcontract")) {
+        mode = FPMode::Contract;
+    } else if (proto.hasAttribute("fastmath")) {
+        mode = FPMode::Fast;
+    }
+
+    llvm::FastMathFlags flags;
+
+    if (mode == FPMode::Fast) {
+        flags.setFast();
 
-    if (!m_Lexer->hasFile()) {
-        std::cerr << "(YAPL)>>>";
+        // The backend reads these for its own fast-math combines.
+        function->addFnAttr("unsafe-fp-math", "true");
+        function->addFnAttr("no-infs-fp-math", "true");
+        function->addFnAttr("no-nans-fp-math", "true");
+        function->addFnAttr("no-signed-zeros-fp-math", "true");
+    } else if (mode == FPMode::Contract) {
+        flags.setAllowContract();
     }
-    std::shared_ptr<ExprAST> expr = m_Parser.parseNext();
 
-    while (!(std::dynamic_pointer_cast<EOFExprAST>(expr))) {
+    m_Builder->setFastMathFlags(flags);
+}
 
-        if (auto parsedExpr = std::dynamic_pointer_cast<DeclarationAST>(expr)) {
-            fprintf(stderr, "Read declaration:\n");
-            if (auto *declaration = generateDeclaration(std::move(parsedExpr))) {
-                declaration->print(llvm::errs());
-                if (auto errOrModule = m_YAPLJIT->addModule(std::move(m_Module))){
-                    reloadModuleAndPassManger();
-                } else {
-                    std::cout << "Error while adding the module" << std::endl;
-                }
-            }
-        } else if (expr) {
-            std::cerr << "Read top level:\n";
-            auto *topLevel = generateTopLevel(std::move(expr));
-            topLevel->print(llvm::errs());
-            auto type = topLevel->getType()->getPointerElementType();
-
-            bool isFloat = false;
-            if (auto fType = static_cast<llvm::FunctionType*>(type)) {
-                isFloat = fType->getReturnType()->isDoubleTy();
-            }
+void IRGenerator::reloadModuleAndPassManger() {
+    m_Module = std::make_unique<llvm::Module>("JIT", m_Context);
+    m_Module->setDataLayout(m_YAPLJIT->getDataLayout());
+    createDebugInfo();
+    m_PassManager = std::make_unique<PassManager>(m_Module.get(), &m_YAPLJIT->getTargetMachine());
+}
 
-            fprintf(stderr, "\n");
-            auto H = m_YAPLJIT->addModule(std::move(m_Module));
-            reloadModuleAndPassManger();
+llvm::Error IRGenerator::addModuleToJIT() {
+    if (m_DIBuilder) {
+        m_DIBuilder->finalize();
+    }
+
+    // Linked before the JIT compiles and frees the module.
+    if (m_ExportModule && llvm::Linker::linkModules(*m_ExportModule, llvm::CloneModule(*m_Module))) {
+        return llvm::make_error<llvm::StringError>("Failed to link the module for --emit-bc",
+                llvm::inconvertibleErrorCode());
+    }
 
-            auto errOrSymbol = m_YAPLJIT->lookup(std::to_string(m_Parser.getAnonFuncNum()));
+    auto err = m_YAPLJIT->addModule(llvm::orc::ThreadSafeModule(std::move(m_Module), m_TSContext));
+    reloadModuleAndPassManger();
 
-            if (!errOrSymbol) {
-                auto err = errOrSymbol.takeError();
-            }
+    if (err) {
+        return err;
+    }
 
-            auto exprSymbol = errOrSymbol.get();
+    // A failed compilation is final, a function is only compiled once those it
+    // calls have stubs.
+    for (auto stub = m_EagerStubs.begin(); stub != m_EagerStubs.end();) {
+        if (callsUndefinedFunction(*stub)) {
+            ++stub;
+            continue;
+        }
 
-            assert(exprSymbol && "Function not found");
-            if (isFloat) {
-                double (*FP)() = (double(*)())(intptr_t)exprSymbol.getAddress();
+        std::string name = *stub;
+        stub = m_EagerStubs.erase(stub);
 
-                fprintf(stderr, "Evaluated to %f\n", FP());
-            } else {
-                int (*FP)() = (int(*)())(intptr_t)exprSymbol.getAddress();
-                fprintf(stderr, "Evaluated to %d\n", FP());
-            }
+        if (auto err = m_YAPLJIT->resolveStub(name)) {
+            return err;
+        }
+    }
+
+    // Batch wrappers of the functions redefined in the module.
+    auto staleBatches = std::move(m_StaleBatches);
+    m_StaleBatches.clear();
+
+    for (const auto &batch : staleBatches) {
+        if (auto err = generateBatch(batch)) {
+            return err;
+        }
+    }
+
+    // Once the functions they fold calls to are compiled, each in its own module.
+    auto staleFolds = std::move(m_StaleFolds);
+    m_StaleFolds.clear();
+
+    for (const auto &stale : staleFolds) {
+        auto body = m_FunctionBodies.find(stale);
 
-            m_Parser.incrementAnonFuncNum();
+        if (body == m_FunctionBodies.end() || !generateFunctionVersion(body->second)) {
+            return llvm::make_error<llvm::StringError>("Failed to generate " + stale + " again",
+                    llvm::inconvertibleErrorCode());
         }
 
-        if (!m_Lexer->hasFile()) {
-            std::cerr << "(YAPL)>>>";
+        if (auto err = addModuleToJIT()) {
+            return err;
         }
-        expr = m_Parser.parseNext();
     }
+
+    return runInitializers();
 }
 
-/******************** ExprAST ********************************************/
+// Stores the values of the globals defined by the module just added.
+llvm::Error IRGenerator::runInitializers() {
+    auto initializers = std::move(m_PendingInitializers);
+    m_PendingInitializers.clear();
 
-llvm::Value *IRGenerator::generateTopLevel(std::shared_ptr<ExprAST> parsedExpression) {
-    if (auto parsedNumber = std::dynamic_pointer_cast<NumberExprAST>(parsedExpression)) {
-        if (std::dynamic_pointer_cast<IntExprAST>(parsedNumber)) {
-            int intVal = parsedNumber->getValue().ival;
-            return llvm::ConstantInt::get(m_Context, llvm::APInt(32, intVal));
+    for (const auto &initializer : initializers) {
+        auto symbol = m_YAPLJIT->lookup(initializer);
+
+        if (!symbol) {
+            return symbol.takeError();
         }
-        if (std::dynamic_pointer_cast<FloatExprAST>(parsedNumber)) {
-            double floatVal = parsedNumber->getValue().fval;
-            return llvm::ConstantFP::get(m_Context, llvm::APFloat(floatVal));
+
+        ((void(*)())(intptr_t)symbol->getAddress())();
+
+        if (m_ExportModule) {
+            m_ExportedEntries.push_back(initializer);
         }
-        std::cerr << "Number expression not recognized" << std::endl;
-        return nullptr;
     }
 
-    if (auto anonExpr = std::dynamic_pointer_cast<AnonExprAst>(parsedExpression)) {
-        auto functionBlocks = std::vector<std::shared_ptr<ExprAST>>();
-        auto anonFuncExpr = std::make_shared<FunctionDefinitionAST>(anonExpr->getProto(),
-                std::move(functionBlocks), anonExpr->getExpr());
+    return llvm::Error::success();
+}
+
+/******************** Benchmark ********************************************/
+
+/*
+ * Times call, such as "kernel(1000, 2.5)", a function of the program called
+ * with literal arguments. The current definition of the function is looked
+ * up in the JIT and called by `void name.bench(i64 count)`, a loop whose
+ * arguments the optimizer cannot see through, run by Benchmark.
+ */
+llvm::Error IRGenerator::benchmark(const std::string &call) {
+    auto makeError = [&call](const std::string &message) {
+        return llvm::make_error<llvm::StringError>(call + ": " + message, llvm::inconvertibleErrorCode());
+    };
+
+    llvm::StringRef name, rest;
+    std::tie(name, rest) = llvm::StringRef(call).split('(');
+    name = name.trim();
+    rest = rest.trim();
+
+    if (!rest.consume_back(")")) {
+        return makeError("expected a call such as f(1, 2.5)");
+    }
 
-        auto function = generateFunctionDefinition(std::move(anonFuncExpr));
+    auto proto = getPrototype(name.str());
+    auto version = m_Versions.find(name.str());
 
-        return function;
+    if (!proto || version == m_Versions.end()) {
+        return makeError("no function " + name.str() + " is defined");
     }
 
-    if (auto parsedVariable = std::dynamic_pointer_cast<VariableExprAST>(parsedExpression)) {
-        llvm::Value* val = m_NamedValues[parsedVariable->getIdentifier()];
-        if(!val) {
-            std::cerr << "Unknown variable" << std::endl;
-            return nullptr;
+    llvm::SmallVector<llvm::StringRef, 8> texts;
+    if (!rest.trim().empty()) {
+        rest.split(texts, ',');
+    }
+
+    if (texts.size() != proto->getParams().size()) {
+        return makeError(name.str() + "() expects " + std::to_string(proto->getParams().size()) + " arguments");
+    }
+
+    initializeJIT();
+
+    std::vector<llvm::Value *> args;
+
+    for (size_t i = 0; i < texts.size(); i++) {
+        llvm::StringRef text = texts[i].trim();
+        llvm::Type *type = getLLVMType(proto->getParams()[i]->getType());
+        int64_t integer;
+        double real;
+
+        // getAsInteger and getAsDouble return true on failure.
+        if (type->isIntegerTy() && !text.getAsInteger(10, integer)) {
+            args.push_back(llvm::ConstantInt::get(type, integer, true));
+        } else if (type->isFloatingPointTy() && !text.getAsDouble(real)) {
+            args.push_back(llvm::ConstantFP::get(type, real));
+        } else {
+            return makeError("argument " + std::to_string(i + 1) + " must be a literal of type " +
+                             proto->getParams()[i]->getType());
         }
+    }
+
+    // Compiles the function, called directly rather than through its stub.
+    auto function = m_YAPLJIT->lookup(versionedFunctionName(name.str(), version->second));
 
-        return val;
+    if (!function) {
+        return function.takeError();
     }
 
-    if (auto parsedBin = std::dynamic_pointer_cast<BinaryOpExprAST>(parsedExpression)) {
-        return generateBinary(std::move(parsedBin));
+    std::string symbol = benchFunctionName(name.str());
+    auto module = std::make_unique<llvm::Module>(symbol, m_Context);
+    module->setDataLayout(m_YAPLJIT->getDataLayout());
+
+    llvm::Type *int64Type = llvm::Type::getInt64Ty(m_Context);
+    llvm::FunctionType *functionType = getFunction(name.str())->getFunctionType();
+    auto *loop = llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(m_Context), {int64Type}, false),
+                                        llvm::Function::ExternalLinkage, symbol, module.get());
+
+    llvm::BasicBlock *entryBlock = llvm::BasicBlock::Create(m_Context, "entry", loop);
+    llvm::BasicBlock *loopBlock = llvm::BasicBlock::Create(m_Context, "loop", loop);
+    llvm::BasicBlock *afterBlock = llvm::BasicBlock::Create(m_Context, "after", loop);
+    llvm::IRBuilder<> builder(entryBlock);
+    builder.CreateBr(loopBlock);
+
+    builder.SetInsertPoint(loopBlock);
+    llvm::PHINode *index = builder.CreatePHI(int64Type, 2, "i");
+    index->addIncoming(builder.getInt64(0), entryBlock);
+
+    llvm::Constant *callee = llvm::ConstantExpr::getIntToPtr(builder.getInt64(function->getAddress()),
+                                                             functionType->getPointerTo());
+    builder.CreateCall(functionType, callee, args);
+
+    llvm::Value *next = builder.CreateAdd(index, builder.getInt64(1), "next");
+    index->addIncoming(next, loopBlock);
+    builder.CreateCondBr(builder.CreateICmpSLT(next, loop->getArg(0)), loopBlock, afterBlock);
+
+    builder.SetInsertPoint(afterBlock);
+    builder.CreateRetVoid();
+
+    if (auto err = m_YAPLJIT->addModule(llvm::orc::ThreadSafeModule(std::move(module), m_TSContext))) {
+        return err;
     }
 
-    if (auto parsedCall = std::dynamic_pointer_cast<CallFunctionExprAST>(parsedExpression)) {
-        auto call = generateFunctionCall(std::move(parsedCall));
-        return call;
+    auto loopSymbol = m_YAPLJIT->lookup(symbol);
+
+    if (!loopSymbol) {
+        return loopSymbol.takeError();
     }
 
-    return nullptr;
+    auto result = Benchmark::run((Benchmark::Loop)(intptr_t)loopSymbol->getAddress());
+    Benchmark::print(Logger::stream(), call, result);
+
+    return llvm::Error::success();
 }
 
-llvm::Value *IRGenerator::generateBinary(std::shared_ptr<BinaryOpExprAST> parsedBinaryOpExpr) {
-    char op = parsedBinaryOpExpr->getOp();
+/******************** Bitcode ********************************************/
+
+/*
+ * The exported module holds every module added to the JIT, optimized, and
+ * named metadata read back when loading it:
+ *  - yapl.entries: the top level expressions and the initializers of the
+ *    globals, `void()` functions, in the order they ran,
+ *  - yapl.functions: the prototype of every function, as its name, its type
+ *    then the type and name of each parameter,
+ *  - yapl.globals: the name and type of every global variable,
+ *  - yapl.versions: the name of every function and the number of its last
+ *    definition, see versionedFunctionName.
+ */
+llvm::Error IRGenerator::writeBitcode(const std::string &path) {
+    llvm::Module &module = *m_ExportModule;
+
+    auto string = [this](const std::string &str) { return llvm::MDString::get(m_Context, str); };
+
+    // Calls go through the stub named after the function, which becomes an
+    // alias to its last definition.
+    llvm::NamedMDNode *versions = module.getOrInsertNamedMetadata("yapl.versions");
+    for (const auto &version : m_Versions) {
+        llvm::Function *implementation = module.getFunction(versionedFunctionName(version.first, version.second));
+        llvm::Function *stub = module.getFunction(version.first);
+
+        if (!implementation || implementation->isDeclaration() || (stub && !stub->isDeclaration())) {
+            continue;
+        }
 
-    auto LHS = parsedBinaryOpExpr->getLHS();
-    auto RHS = parsedBinaryOpExpr->getRHS();
+        auto *alias = llvm::GlobalAlias::create(llvm::GlobalValue::ExternalLinkage, "", implementation);
 
-    llvm::Value *L = generateTopLevel(std::move(LHS));
-    llvm::Value *R = generateTopLevel(std::move(RHS));
+        if (stub) {
+            stub->replaceAllUsesWith(llvm::ConstantExpr::getBitCast(alias, stub->getType()));
+            stub->eraseFromParent();
+        }
 
-    if(!L || !R)
-        return nullptr;
+        alias->setName(version.first);
+        versions->addOperand(llvm::MDNode::get(m_Context, {
+                string(version.first), string(std::to_string(version.second)) }));
+    }
 
-    if (L->getType() != R->getType()) {
-        R->mutateType(L->getType());
+    llvm::NamedMDNode *entries = module.getOrInsertNamedMetadata("yapl.entries");
+    for (const auto &entry : m_ExportedEntries) {
+        entries->addOperand(llvm::MDNode::get(m_Context, string(entry)));
     }
 
+    llvm::NamedMDNode *functions = module.getOrInsertNamedMetadata("yapl.functions");
+    for (const auto &function : m_FunctionDefs) {
+        std::vector<llvm::Metadata *> fields = { string(function.first), string(function.second->getType()) };
 
-    if (parsedBinaryOpExpr->getType() == "float") {
-        switch (op) {
-            case '+':
-                return m_Builder->CreateFAdd(L, R, "addtmp");
-            case '-':
-                return m_Builder->CreateFSub(L, R, "subtmp");
-            case '*':
-                return m_Builder->CreateFMul(L, R, "multmp");
-            case '<':
-                L = m_Builder->CreateFCmpULT(L, R, "cmptmp");
-                return m_Builder->CreateUIToFP(L, llvm::Type::getDoubleTy(m_Context), "booltmp");
-            default:
-                std::cerr << "Invalid binary operator" << std::endl;
-                return nullptr;
-        }
-    } else {
-        switch (op) {
-            case '+':
-                return m_Builder->CreateAdd(L, R, "addtmp");
-            case '-':
-                return m_Builder->CreateSub(L, R, "subtmp");
-            case '*':
-                return m_Builder->CreateMul(L, R, "multmp");
-            case '<':
-                return m_Builder->CreateICmpULT(L, R, "cmptmp");
-            default:
-                std::cerr << "Invalid binary operator" << std::endl;
-                return nullptr;
+        for (const auto &param : function.second->getParams()) {
+            fields.push_back(string(param->getType()));
+            fields.push_back(string(param->getName()));
         }
+
+        functions->addOperand(llvm::MDNode::get(m_Context, fields));
+    }
+
+    llvm::NamedMDNode *globals = module.getOrInsertNamedMetadata("yapl.globals");
+    for (const auto &global : m_Globals) {
+        globals->addOperand(llvm::MDNode::get(m_Context, { string(global.first), string(global.second) }));
     }
 
+    if (m_YAPLJIT) {
+        module.setTargetTriple(m_YAPLJIT->getTargetMachine().getTargetTriple().str());
+        module.setDataLayout(m_YAPLJIT->getDataLayout());
+    }
+
+    if (llvm::verifyModule(module, &Logger::llvmStream())) {
+        return llvm::make_error<llvm::StringError>("The exported module is invalid", llvm::inconvertibleErrorCode());
+    }
+
+    std::error_code error;
+    llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_None);
+
+    if (error) {
+        return llvm::make_error<llvm::StringError>("Cannot write " + path + ": " + error.message(), error);
+    }
+
+    llvm::WriteBitcodeToFile(module, out);
+    return llvm::Error::success();
 }
 
-llvm::Value *IRGenerator::generateFunctionCall(std::shared_ptr<CallFunctionExprAST> parsedFunctionCall) {
-    llvm::Function *calleeFunction = getFunction(parsedFunctionCall->getCallee());
-    if (!calleeFunction) {
-        std::cerr << "Unknown function called" << std::endl;
-        return nullptr;
+// Adds a module written by --emit-bc to the JIT, possibly optimized offline
+// since, declares its functions to the parser then runs its top level
+// expressions. The alias of each function is replaced by a stub to its last
+// definition, redefining it continues its numbering.
+llvm::Error IRGenerator::loadBitcode(const std::string &path) {
+    initializeJIT();
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return llvm::make_error<llvm::StringError>("Cannot read " + path + ": " + buffer.getError().message(),
+                buffer.getError());
     }
 
-    auto args = parsedFunctionCall->getArgs();
-    std::vector<llvm::Value *> callArgs;
-    if (calleeFunction->arg_size() != args.size()) {
-        return nullptr;
+    auto module = llvm::parseBitcodeFile(**buffer, m_Context);
+    if (!module) {
+        return module.takeError();
     }
 
-    for (const auto &arg : args) {
-        llvm::Value *argVal = generateTopLevel(std::move(arg));
-        callArgs.push_back(argVal);
+    auto invalid = [&path]() {
+        return llvm::make_error<llvm::StringError>("Invalid YAPL module: " + path, llvm::inconvertibleErrorCode());
+    };
 
-        if(!callArgs.back()) {
-            return nullptr;
+    if (llvm::verifyModule(**module, &Logger::llvmStream())) {
+        return invalid();
+    }
+
+    auto string = [](const llvm::MDNode *node, unsigned i, std::string &str) {
+        auto *field = i < node->getNumOperands() ? llvm::dyn_cast_or_null<llvm::MDString>(node->getOperand(i)) : nullptr;
+
+        if (field) {
+            str = field->getString().str();
+        }
+
+        return field != nullptr;
+    };
+
+    std::vector<std::shared_ptr<PrototypeAST>> protos;
+
+    if (auto *functions = (*module)->getNamedMetadata("yapl.functions")) {
+        for (const llvm::MDNode *function : functions->operands()) {
+            std::string name, type;
+
+            if (!string(function, 0, name) || !string(function, 1, type) || function->getNumOperands() % 2 != 0) {
+                return invalid();
+            }
+
+            std::vector<std::shared_ptr<DeclarationAST>> params;
+
+            for (unsigned i = 2; i < function->getNumOperands(); i += 2) {
+                std::string paramType, paramName;
+
+                if (!string(function, i, paramType) || !string(function, i + 1, paramName)) {
+                    return invalid();
+                }
+
+                params.push_back(std::make_shared<DeclarationAST>(paramType, paramName));
+            }
+
+            protos.push_back(std::make_shared<PrototypeAST>(std::make_shared<DeclarationAST>(type, name),
+                                                            std::move(params)));
         }
     }
-    return m_Builder->CreateCall(calleeFunction, callArgs, "calltmp");
-}
 
-/******************** DeclarationAST ********************************************/
+    std::map<std::string, std::string> globals;
 
+    if (auto *globalNodes = (*module)->getNamedMetadata("yapl.globals")) {
+        for (const llvm::MDNode *global : globalNodes->operands()) {
+            std::string name, type;
 
-llvm::Function *IRGenerator::generateDeclaration(std::shared_ptr<DeclarationAST> parsedDeclaration) {
+            if (!string(global, 0, name) || !string(global, 1, type) || !getLLVMType(type)) {
+                return invalid();
+            }
 
-    if (auto parsedDefinition = std::dynamic_pointer_cast<FunctionDefinitionAST>(parsedDeclaration)) {
-        return generateFunctionDefinition(std::move(parsedDefinition));
+            globals[name] = type;
+        }
     }
 
-    if (auto parsedProto = std::dynamic_pointer_cast<PrototypeAST>(parsedDeclaration)) {
-        return generatePrototype(std::move(parsedProto));
+    std::map<std::string, int> versions;
+    std::vector<std::string> eagerStubs;
+
+    if (auto *versionNodes = (*module)->getNamedMetadata("yapl.versions")) {
+        for (const llvm::MDNode *version : versionNodes->operands()) {
+            std::string name, number;
+            int value = 0;
+
+            if (!string(version, 0, name) || !string(version, 1, number) ||
+                    llvm::StringRef(number).getAsInteger(10, value) || value <= 0) {
+                return invalid();
+            }
+
+            llvm::Function *implementation = (*module)->getFunction(versionedFunctionName(name, value));
+
+            if (!implementation || implementation->isDeclaration()) {
+                return invalid();
+            }
+
+            // Calls go through the stub defined once the module is added.
+            if (auto *alias = (*module)->getNamedAlias(name)) {
+                auto *stub = llvm::Function::Create(implementation->getFunctionType(),
+                                                    llvm::Function::ExternalLinkage, "", module->get());
+                alias->replaceAllUsesWith(llvm::ConstantExpr::getBitCast(stub, alias->getType()));
+                alias->eraseFromParent();
+                stub->setName(name);
+            }
+
+            versions[name] = value;
+
+            if (hasVectorParameter(implementation) || m_YAPLJIT->isConcurrent()) {
+                eagerStubs.push_back(name);
+            }
+        }
     }
 
-    return nullptr;
-}
+    // Renamed, the input's own top level expressions are numbered from 0 too.
+    std::vector<std::pair<std::string, llvm::FunctionType *>> entries;
 
-llvm::Function *IRGenerator::generatePrototype(std::shared_ptr<PrototypeAST> parsedPrototype) {
-    auto params = parsedPrototype->getParams();
-    std::vector<llvm::Type *> paramTypes;
+    if (auto *entryNodes = (*module)->getNamedMetadata("yapl.entries")) {
+        for (const llvm::MDNode *entry : entryNodes->operands()) {
+            std::string name;
+            llvm::Function *function = string(entry, 0, name) ? (*module)->getFunction(name) : nullptr;
 
-    for (const auto &param : params) {
-        if (param->getType() == "int") {
-            paramTypes.push_back(llvm::Type::getInt32Ty(m_Context));
-        } else if (param->getType() == "float") {
-            paramTypes.push_back(llvm::Type::getDoubleTy(m_Context));
-        } else {
-            std::cerr << "Unknown param type: " << param->getType() << " param ignored!" << std::endl;
+            if (!function || function->isDeclaration()) {
+                return invalid();
+            }
+
+            function->setName(name + ".bc");
+            entries.emplace_back(function->getName().str(), function->getFunctionType());
         }
     }
 
-    llvm::FunctionType * functionType;
+    if (auto err = m_YAPLJIT->addModule(llvm::orc::ThreadSafeModule(std::move(*module), m_TSContext))) {
+        return err;
+    }
 
-    if (parsedPrototype->getType() == "int") {
-        functionType = llvm::FunctionType::get(llvm::Type::getInt32Ty(m_Context), paramTypes, false);
-    } else if (parsedPrototype->getType() == "float") {
-        functionType = llvm::FunctionType::get(llvm::Type::getDoubleTy(m_Context), paramTypes, false);
-    } else {
-        std::cerr << "Unknown function type: " << parsedPrototype->getType() << " function ignored!" << std::endl;
-        return nullptr;
+    for (auto &proto : protos) {
+        m_Parser.declare(*proto);
+        m_FunctionDefs[proto->getName()] = std::move(proto);
     }
+    NumFunctionDefs.set(m_FunctionDefs.size());
 
-    llvm::Function *function = llvm::Function::Create(
-            functionType,
-            llvm::Function::ExternalLinkage,
-            parsedPrototype->getName(),
-            m_Module.get());
+    for (const auto &global : globals) {
+        m_Parser.declareVariable(global.first, global.second);
+        m_Globals[global.first] = global.second;
+    }
 
-    unsigned idx = 0;
-    for (auto &arg : function->args()) {
-        arg.setName(params[idx++]->getName());
+    for (const auto &version : versions) {
+        std::string implementation = versionedFunctionName(version.first, version.second);
+        m_Versions[version.first] = version.second;
+
+        if (auto err = m_YAPLJIT->defineStub(version.first, implementation)) {
+            return err;
+        }
     }
 
-    return function;
+    for (const auto &stub : eagerStubs) {
+        if (auto err = m_YAPLJIT->resolveStub(stub)) {
+            return err;
+        }
+    }
+
+    for (const auto &entry : entries) {
+        llvm::FunctionType *type = entry.second;
+
+        if (!type->getReturnType()->isVoidTy() || type->getNumParams() != 0) {
+            evaluateTopLevel(entry.first, type);
+            continue;
+        }
+
+        auto initializer = m_YAPLJIT->lookup(entry.first);
+        if (!initializer) {
+            return initializer.takeError();
+        }
+
+        ((void(*)())(intptr_t)initializer->getAddress())();
+    }
+
+    return llvm::Error::success();
 }
 
-llvm::Function *IRGenerator::generateFunctionDefinition(std::shared_ptr<FunctionDefinitionAST> parsedFunctionDefinition) {
-    auto &proto = *parsedFunctionDefinition->getPrototype().get();
-    auto p = parsedFunctionDefinition->getPrototype();
-    m_FunctionDefs[p->getName()] = std::move(p);
+/******************** Debug info ********************************************/
 
-    llvm::Function *function = getFunction(proto.getName());
+void IRGenerator::createDebugInfo() {
+    m_DIBuilder = nullptr;
+    m_DICompileUnit = nullptr;
 
-    if (!function) {
-        return nullptr;
+    if (!m_Options.debugInfo) {
+        return;
     }
 
-    if (!function->empty()) {
-        std::cerr << "Function cannot be redefined!" << std::endl;
+    llvm::SmallString<128> directory;
+    llvm::sys::fs::current_path(directory);
+
+    std::string fileName = m_Lexer->hasFile() ? m_Options.inputPath : "<stdin>";
+
+    m_DIBuilder = std::make_unique<llvm::DIBuilder>(*m_Module);
+    m_DICompileUnit = m_DIBuilder->createCompileUnit(
+            llvm::dwarf::DW_LANG_C,
+            m_DIBuilder->createFile(fileName, directory),
+            "YAPL",
+            true,
+            "",
+            0);
+
+    m_Module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    m_Module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+llvm::DIType *IRGenerator::getDebugType(const std::string &type) {
+    std::string element = elementType(type);
+    uint64_t elementBits = getLLVMType(element)->getPrimitiveSizeInBits();
+
+    if (unsigned width = vectorWidth(type)) {
+        llvm::Metadata *subscripts[] = { m_DIBuilder->getOrCreateSubrange(0, width) };
+
+        return m_DIBuilder->createVectorType(width * elementBits, 0, getDebugType(element),
+                m_DIBuilder->getOrCreateArray(subscripts));
     }
 
-    llvm::BasicBlock *basicBlock = llvm::BasicBlock::Create(m_Context, "entry", function);
-    m_Builder->SetInsertPoint(basicBlock);
+    return m_DIBuilder->createBasicType(type, elementBits,
+            isFloatType(type) ? llvm::dwarf::DW_ATE_float : llvm::dwarf::DW_ATE_signed);
+}
 
-    m_NamedValues.clear();
+llvm::DISubprogram *IRGenerator::generateDebugSubprogram(const PrototypeAST &proto, llvm::Function *function) {
+    if (!m_DIBuilder) {
+        return nullptr;
+    }
 
-    for (auto &arg : function->args()) {
-        m_NamedValues[arg.getName().str()] = &arg;
+    llvm::SmallVector<llvm::Metadata *, 8> types;
+    types.push_back(getDebugType(proto.getType()));
+    for (const auto &param : proto.getParams()) {
+        types.push_back(getDebugType(param->getType()));
     }
-    auto returnExpr = parsedFunctionDefinition->getReturnExpr();
-    if (llvm::Value *retValue = generateTopLevel(returnExpr)) {
-        if (retValue->getType() != function->getReturnType())
-            retValue->mutateType(function->getReturnType());
 
-        m_Builder->CreateRet(retValue);
+    llvm::DIFile *file = m_DICompileUnit->getFile();
+    unsigned line = proto.getLine();
 
-        llvm::verifyFunction(*function);
+    llvm::DISubprogram *subprogram = m_DIBuilder->createFunction(
+            file,
+            proto.getName(),
+            llvm::StringRef(),
+            file,
+            line,
+            m_DIBuilder->createSubroutineType(m_DIBuilder->getOrCreateTypeArray(types)),
+            line,
+            llvm::DINode::FlagPrototyped,
+            llvm::DISubprogram::SPFlagDefinition);
 
-        m_PassManager->run(*function);
+    function->setSubprogram(subprogram);
 
-        return function;
-    }
+    return subprogram;
+}
 
-    function->eraseFromParent();
+void IRGenerator::emitLocation(const ExprAST *expr) {
+    if (!m_DISubprogram || !expr || expr->getLine() == 0) {
+        return;
+    }
 
-    return function;
+    m_Builder->SetCurrentDebugLocation(
+            llvm::DILocation::get(m_Context, expr->getLine(), expr->getColumn(), m_DISubprogram));
 }
 
-void IRGenerator::reloadModuleAndPassManger() {
-    m_Module = std::make_unique<llvm::Module>("JIT", m_Context);
-    m_Module->setDataLayout(m_YAPLJIT->getDataLayout());
-    m_PassManager = std::make_unique<PassManager>(m_Module.get());
+// int and float are i32 and double, f32[8] is <8 x float>.
+llvm::Type *IRGenerator::getLLVMType(const std::string &type) {
+    llvm::Type *elementLLVMType;
+
+    switch (strToType(elementType(type))) {
+        case type_char:
+            elementLLVMType = llvm::Type::getInt8Ty(m_Context);
+            break;
+        case type_i16:
+            elementLLVMType = llvm::Type::getInt16Ty(m_Context);
+            break;
+        case type_int:
+            elementLLVMType = llvm::Type::getInt32Ty(m_Context);
+            break;
+        case type_i64:
+            elementLLVMType = llvm::Type::getInt64Ty(m_Context);
+            break;
+        case type_f32:
+            elementLLVMType = llvm::Type::getFloatTy(m_Context);
+            break;
+        case type_float:
+            elementLLVMType = llvm::Type::getDoubleTy(m_Context);
+            break;
+        default:
+            return nullptr;
+    }
+
+    if (unsigned width = vectorWidth(type)) {
+        return llvm::FixedVectorType::get(elementLLVMType, width);
+    }
+
+    return elementLLVMType;
 }
 
+// Functions defined in the module being generated, which has none other when
+// generating a REPL input, are called directly rather than through their stub.
 llvm::Function *IRGenerator::getFunction(const std::string &name) {
+    auto version = m_Versions.find(name);
+
+    if (version != m_Versions.end()) {
+        if (auto *func = m_Module->getFunction(versionedFunctionName(name, version->second))) {
+            return func;
+        }
+    }
+
     if (auto *func = m_Module->getFunction(name)) {
         return func;
     }
@@ -6,46 +6,93 @@
 #include <cstring>
 #include <iostream>
 
+#include <llvm/ADT/StringRef.h>
+
 #include "Lexer/Lexer.hpp"
+#include "Logger/Logger.hpp"
+#include "Statistics/Statistics.hpp"
+#include "TimeReport/TimeReport.hpp"
+#include "helper/helper.hpp"
+
+YAPL_STATISTIC(NumTokens, "lexer", "Number of tokens lexed");
+
+// Widest vector type, its elements are all kept in registers or on the stack.
+static constexpr unsigned s_MaxVectorWidth = 1024;
 
 Lexer::Lexer(const char *path) {
     m_HasFile = strlen(path) != 0;
 
-    m_File = m_HasFile ? std::fopen(path, "r") : nullptr;
+    m_File = m_HasFile ? std::fopen(path, "r") : stdin;
 
     if (!m_File && m_HasFile) {
         std::string str("Failed to open file: ");
         str += path;
         std::perror(str.c_str());
     } else if (m_HasFile) {
-        std::cout << "File opened successfully" << std::endl;
+        YAPL_LOG(Debug) Logger::stream() << "File opened successfully" << std::endl;
     }
 }
 
 Lexer::~Lexer() {
-    if (m_HasFile) {
+    if (m_HasFile && m_File) {
         std::fclose(m_File);
     }
 }
 
+std::shared_ptr<Lexer> Lexer::fromSource(std::string source) {
+    auto lexer = std::make_shared<Lexer>("");
+    lexer->m_HasSource = true;
+    lexer->m_Source = std::move(source);
+
+    return lexer;
+}
+
+std::shared_ptr<Lexer> Lexer::fromStream(std::FILE *file) {
+    auto lexer = std::make_shared<Lexer>("");
+    lexer->m_File = file;
+
+    return lexer;
+}
+
 int Lexer::getChar() {
-    m_CurrentChar = !m_HasFile ?
-        std::fgetc(stdin) :
-        std::fgetc(m_File);
+    if (m_HasSource) {
+        m_CurrentChar = m_SourcePosition < m_Source.size() ?
+            static_cast<unsigned char>(m_Source[m_SourcePosition++]) :
+            EOF;
+    } else {
+        m_CurrentChar = std::fgetc(m_File);
+    }
     m_CharCount++;
+    m_ColumnCount++;
     if (m_CurrentChar == '\n'){
         m_LineCount++;
+        m_ColumnCount = 0;
     }
 
     return m_CurrentChar;
 }
 
 Token Lexer::getToken() {
+    TimeReport::Scope timer(Phase::Lex);
+    ++NumTokens;
+
+    Token token = lexToken();
+    token.line = m_TokenLine;
+    token.column = m_TokenColumn;
+
+    return token;
+}
+
+Token Lexer::lexToken() {
 
     while (isspace(m_CurrentChar)) {
         getChar();
     }
 
+    // m_CurrentChar is the first character of the token.
+    m_TokenLine = m_LineCount;
+    m_TokenColumn = m_ColumnCount;
+
     std::string test;
 
     switch (m_CurrentChar) {
@@ -53,8 +100,29 @@ Token Lexer::getToken() {
             getChar();
             return Token{ token::tok_sc };
         case '=':
-            getChar();
+            if (getChar() == '=') {
+                getChar();
+                return Token{ token::tok_cmp_eq };
+            }
             return Token{ token::tok_eq };
+        case '!':
+            if (getChar() == '=') {
+                getChar();
+                return Token{ token::tok_cmp_ne };
+            }
+            return Token{ '!' };
+        case '<':
+            if (getChar() == '=') {
+                getChar();
+                return Token{ token::tok_cmp_le };
+            }
+            return Token{ '<' };
+        case '>':
+            if (getChar() == '=') {
+                getChar();
+                return Token{ token::tok_cmp_ge };
+            }
+            return Token{ '>' };
         case '(':
             getChar();
             return Token{ token::tok_popen };
@@ -76,6 +144,16 @@ Token Lexer::getToken() {
 
 
 
+    if (m_CurrentChar == '#') {
+        m_Identifier = "";
+
+        while (isalnum(getChar())) {
+            m_Identifier += m_CurrentChar;
+        }
+
+        return Token{ token::tok_command, m_Identifier };
+    }
+
     if (isalpha(m_CurrentChar)) {
         m_Identifier = m_CurrentChar;
 
@@ -91,11 +169,53 @@ Token Lexer::getToken() {
             return Token{ token::tok_return };
         }
 
-        if (m_Identifier == "float") {
-            return Token{ token::tok_type, m_Identifier };
+        if (m_Identifier == "for") {
+            return Token{ token::tok_for };
+        }
+
+        if (m_Identifier == "while") {
+            return Token{ token::tok_while };
+        }
+
+        if (m_Identifier == "parallel") {
+            return Token{ token::tok_parallel };
+        }
+
+        if (m_Identifier == "if") {
+            return Token{ token::tok_if };
+        }
+
+        if (m_Identifier == "else") {
+            return Token{ token::tok_else };
+        }
+
+        if (isFunctionAttribute(m_Identifier)) {
+            return Token{ token::tok_attribute, m_Identifier };
         }
 
-        if (m_Identifier == "int") {
+        if (isTypeName(m_Identifier)) {
+            m_Identifier = canonicalTypeName(m_Identifier);
+
+            // Fixed size vector type, such as float[8].
+            if (m_CurrentChar == '[') {
+                std::string width;
+
+                while (isdigit(getChar())) {
+                    width += m_CurrentChar;
+                }
+
+                unsigned value = 0;
+
+                // getAsInteger fails on an empty or overflowing width.
+                if (m_CurrentChar != ']' || llvm::StringRef(width).getAsInteger(10, value) || value == 0 ||
+                        value > s_MaxVectorWidth) {
+                    Logger::stream() << "Expected a vector width in " << m_Identifier << "[...]" << std::endl;
+                } else {
+                    getChar();
+                    m_Identifier += "[" + std::to_string(value) + "]";
+                }
+            }
+
             return Token{ token::tok_type, m_Identifier };
         }
 
@@ -150,6 +270,10 @@ const int &Lexer::getLineCount() const {
     return m_LineCount;
 }
 
+const int &Lexer::getColumnCount() const {
+    return m_ColumnCount;
+}
+
 const bool Lexer::hasFile() const {
     return m_HasFile;
 }
@@ -14,13 +14,25 @@
 
 #include "AST/DeclarationAST.hpp"
 #include "AST/ExprAST.hpp"
+#include "Logger/Logger.hpp"
 #include "Parser/Parser.hpp"
+#include "Statistics/Statistics.hpp"
 #include "helper/helper.hpp"
 #include "utils/token.hpp"
 
+YAPL_STATISTIC(NumNameTypeEntries, "parser", "Entries in the name/type table (m_NameType)");
+
 Parser::Parser(std::shared_ptr<Lexer> lexer)
         : m_Lexer(std::move(lexer))
 {
+    // Do not consume a token here: it would race with the IO thread and the
+    // first token of the input could be dropped by the first parseNext().
+    m_CurrentToken = Token{ INT_MIN };
+}
+
+// The IO thread is started by the first token request rather than by the
+// constructor, so creating a parser costs nothing until it is used.
+void Parser::startIOThread() {
 
     std::future<void> stopIOFuture = m_StopIOThread.get_future();
 
@@ -31,14 +43,22 @@ Parser::Parser(std::shared_ptr<Lexer> lexer)
             std::lock_guard lock{m_Mutex};
             m_Tokens.push_back(tmp);
             m_ConditionnalVariable.notify_one();
+
+            // Nothing can follow the end of the input, stop lexing.
+            if (tmp.token == tok_eof) {
+                m_LexerDone = true;
+                break;
+            }
         }
 
     }, std::move(stopIOFuture));
-
-    m_CurrentToken = getNextToken();
 }
 
 Token Parser::getNextToken(){
+    if (!m_IO.joinable()) {
+        startIOThread();
+    }
+
     {
         std::unique_lock lock{m_Mutex};
 
@@ -48,6 +68,8 @@ Token Parser::getNextToken(){
                 m_ToProcess.push_back(tok);
             }
             m_Tokens.clear();
+        } else if (m_LexerDone && m_ToProcess.empty()) {
+            return Token{ tok_eof };
         }
     }
 
@@ -78,7 +100,7 @@ void Parser::parse() {
     while (m_CurrentToken.token != tok_eof ||
             (!m_Lexer->hasFile() && true)) {
 
-        std::cerr << "(yapl)>>>";
+        Logger::stream() << "(yapl)>>>";
 
         m_CurrentToken = waitForToken();
 
@@ -100,26 +122,43 @@ std::shared_ptr<ExprAST> Parser::parseNext() {
 
     m_CurrentToken = waitForToken();
 
+    std::shared_ptr<ExprAST> parsed;
+
     switch ( m_CurrentToken.token ) {
         case tok_type:
-            return parseDeclaration();
+            parsed = parseDeclaration();
+            break;
+        case tok_attribute:
+            parsed = parseAttributes();
+            break;
         case tok_include:
-            return nullptr;
+            parsed = nullptr;
+            break;
+        case tok_command:
+            parsed = std::make_shared<CommandAST>(m_CurrentToken.identifier);
+            break;
         case tok_eof:
-            return std::make_unique<EOFExprAST>();
+            parsed = std::make_unique<EOFExprAST>();
+            break;
         default:
-            return parseTopLevelExpr();
+            parsed = parseTopLevelExpr();
+            break;
     }
+
+    NumNameTypeEntries.set(m_NameType.size());
+
+    return parsed;
 }
 
 std::shared_ptr<DeclarationAST> Parser::parseDeclaration(const std::string &scope) {
     std::string dType = m_CurrentToken.identifier;
     std::string dName;
+    Token typeToken = m_CurrentToken;
 
     m_CurrentToken = waitForToken();
 
     if (m_CurrentToken.token != tok_identifier) {
-        std::cerr << "The type must be followed by an identifier!" << std::endl;
+        Logger::stream() << "The type must be followed by an identifier!" << std::endl;
         return nullptr;
     }
 
@@ -130,39 +169,39 @@ std::shared_ptr<DeclarationAST> Parser::parseDeclaration(const std::string &scop
     if (m_CurrentToken.token == tok_popen) {
 
         auto declaration = std::make_shared<DeclarationAST>(dType, dName);
+        declaration->setLocation(typeToken.line, typeToken.column);
         auto proto = parsePrototype(std::move(declaration));
 
-        if (m_CurrentToken.token == tok_sc) {
-            return proto;
-        }
-
-        m_CurrentToken = waitForToken();
+        if (m_CurrentToken.token != tok_sc) {
+            m_CurrentToken = waitForToken();
 
-        if (m_CurrentToken.token == tok_bopen) {
-            return parseDefinition(proto);
-        }
+            if (m_CurrentToken.token == tok_bopen) {
+                return parseDefinition(proto);
+            }
 
-        if (m_CurrentToken.token != tok_sc) {
-            std::cerr << "Expected function body or ';' after prototype" << std::endl;
-            return nullptr;
+            if (m_CurrentToken.token != tok_sc) {
+                Logger::stream() << "Expected function body or ';' after prototype" << std::endl;
+                return nullptr;
+            }
         }
 
-        return proto;
+        return checkBuiltinPrototype(std::move(proto));
     }
 
     if (m_CurrentToken.token == tok_eq) {
         auto declaration = std::make_shared<DeclarationAST>(dType, dName);
+        declaration->setLocation(typeToken.line, typeToken.column);
         std::string variableName = (scope.length() > 0) ?
             scope + "::" + declaration->getName() :
             declaration->getName();
 
         m_NameType[variableName] = declaration->getType();
 
-        return parseVariableDefinition(declaration);
+        return parseVariableDefinition(declaration, scope);
     }
 
     if (m_CurrentToken.token != tok_sc) {
-        std::cerr << "Expected ';' after variable declaration!" << std::endl;
+        Logger::stream() << "Expected ';' after variable declaration!" << std::endl;
         return nullptr;
     }
 
@@ -172,7 +211,45 @@ std::shared_ptr<DeclarationAST> Parser::parseDeclaration(const std::string &scop
 
     m_NameType[variableName] = dType;
 
-    return std::make_shared<DeclarationAST>(dType, dName);
+    auto declaration = std::make_shared<DeclarationAST>(dType, dName);
+    declaration->setLocation(typeToken.line, typeToken.column);
+
+    return declaration;
+}
+
+// attribute... declaration, the attributes only apply to functions.
+std::shared_ptr<DeclarationAST> Parser::parseAttributes() {
+    std::vector<std::string> attributes;
+
+    while (m_CurrentToken.token == tok_attribute) {
+        attributes.push_back(m_CurrentToken.identifier);
+        m_CurrentToken = waitForToken();
+    }
+
+    if (m_CurrentToken.token != tok_type) {
+        Logger::stream() << "Expected a function declaration after " << attributes.back() << std::endl;
+        return nullptr;
+    }
+
+    auto declaration = parseDeclaration();
+    auto proto = std::dynamic_pointer_cast<PrototypeAST>(declaration);
+
+    if (auto definition = std::dynamic_pointer_cast<FunctionDefinitionAST>(declaration)) {
+        proto = definition->getPrototype();
+    }
+
+    if (!proto) {
+        if (declaration) {
+            Logger::stream() << attributes.back() << " only applies to functions" << std::endl;
+        }
+        return nullptr;
+    }
+
+    for (const auto &attribute : attributes) {
+        proto->addAttribute(attribute);
+    }
+
+    return declaration;
 }
 
 void Parser::parseInclude() {
@@ -186,9 +263,12 @@ std::shared_ptr<PrototypeAST> Parser::parsePrototype(std::shared_ptr<Declaration
 
     if (m_CurrentToken.token != tok_type) {
         if (m_CurrentToken.token == tok_pclose) {
-            return std::make_shared<PrototypeAST>(std::move(declarationAST), std::move(args));
+            auto proto = std::make_shared<PrototypeAST>(std::move(declarationAST), std::move(args));
+            declare(*proto);
+
+            return proto;
         } else {
-            std::cerr << "Parameters must be typed!" << std::endl;
+            Logger::stream() << "Parameters must be typed!" << std::endl;
             return nullptr;
         }
     }
@@ -198,7 +278,7 @@ std::shared_ptr<PrototypeAST> Parser::parsePrototype(std::shared_ptr<Declaration
     m_CurrentToken = waitForToken();
 
     if (m_CurrentToken.token != tok_identifier) {
-        std::cerr << "Parameters must be named!" << std::endl;
+        Logger::stream() << "Parameters must be named!" << std::endl;
         return nullptr;
     }
 
@@ -217,7 +297,7 @@ std::shared_ptr<PrototypeAST> Parser::parsePrototype(std::shared_ptr<Declaration
         m_CurrentToken = waitForToken();
 
         if (m_CurrentToken.token != tok_type) {
-            std::cerr << "Parameters must be typed!" << std::endl;
+            Logger::stream() << "Parameters must be typed!" << std::endl;
             return nullptr;
         }
 
@@ -225,7 +305,7 @@ std::shared_ptr<PrototypeAST> Parser::parsePrototype(std::shared_ptr<Declaration
         m_CurrentToken = waitForToken();
 
         if (m_CurrentToken.token != tok_identifier) {
-            std::cerr << "Parameters must be named!" << std::endl;
+            Logger::stream() << "Parameters must be named!" << std::endl;
             return nullptr;
         }
 
@@ -246,31 +326,77 @@ std::shared_ptr<PrototypeAST> Parser::parsePrototype(std::shared_ptr<Declaration
     }
 
     if (m_CurrentToken.token != tok_pclose) {
-        std::cerr << "A ')' is expected at the end of a prototype" << std::endl;
+        Logger::stream() << "A ')' is expected at the end of a prototype" << std::endl;
         return nullptr;
     }
 
 
     auto proto = std::make_shared<PrototypeAST>(declarationAST, args);
+    declare(*proto);
 
-    m_NameType[proto->getName()] = proto->getType();
     return std::move(proto);
 }
 
+// Calls of a builtin name are lowered to the builtin, unless the program
+// defines the function: a prototype without definition must keep the
+// builtin's signature.
+std::shared_ptr<PrototypeAST> Parser::checkBuiltinPrototype(std::shared_ptr<PrototypeAST> proto) {
+    if (!proto) {
+        return nullptr;
+    }
+
+    const std::string &name = proto->getName();
+
+    if (!isReduction(name) && !isMathBuiltin(name)) {
+        return proto;
+    }
+
+    std::vector<std::string> paramTypes;
+    for (const auto &param : proto->getParams()) {
+        paramTypes.push_back(param->getType());
+    }
+
+    if (isBuiltinSignature(name, proto->getType(), paramTypes)) {
+        return proto;
+    }
+
+    Logger::stream() << "The prototype of the builtin " << name << "() does not match its signature, define the "
+        << "function to replace it" << std::endl;
+
+    m_NameType.erase(name);
+    m_ParamTypes.erase(name);
+
+    return nullptr;
+}
+
+void Parser::declare(const PrototypeAST &proto) {
+    m_NameType[proto.getName()] = proto.getType();
+
+    std::vector<std::string> paramTypes;
+    for (const auto &param : proto.getParams()) {
+        paramTypes.push_back(param->getType());
+    }
+    m_ParamTypes[proto.getName()] = std::move(paramTypes);
+}
+
+void Parser::declareVariable(const std::string &name, const std::string &type) {
+    m_NameType[name] = type;
+}
+
 std::shared_ptr<FunctionDefinitionAST> Parser::parseDefinition(std::shared_ptr<PrototypeAST> proto) {
     m_CurrentToken = waitForToken();
 
     std::vector<std::shared_ptr<ExprAST>> blocks;
 
-    while (m_CurrentToken.token != tok_return && m_CurrentToken.token != tok_bclose) {
+    while (m_CurrentToken.token != tok_return && m_CurrentToken.token != tok_bclose &&
+            m_CurrentToken.token != tok_eof) {
+        auto statement = parseStatement(proto->getName());
 
-        if (m_CurrentToken.token == tok_return || m_CurrentToken.token == tok_bclose)
-            break;
+        if (!statement) {
+            return nullptr;
+        }
 
-        if (m_CurrentToken.token == tok_type)
-            blocks.push_back(std::move(parseDeclaration(proto->getName())));
-        else
-            blocks.push_back(std::move(parseExpression(proto->getName())));
+        blocks.push_back(std::move(statement));
     }
 
 
@@ -279,12 +405,20 @@ std::shared_ptr<FunctionDefinitionAST> Parser::parseDefinition(std::shared_ptr<P
         auto expr = parseExpression(proto->getName());
 
         if (!expr) {
-            std::cerr << "Expecting expression after 'return'!" << std::endl;
+            Logger::stream() << "Expecting expression after 'return'!" << std::endl;
+            return nullptr;
+        }
+
+        expr = convertLiteral(std::move(expr), proto->getType());
+
+        if (expr->getType() != proto->getType()) {
+            Logger::stream() << "Cannot return a " << expr->getType() << " from " << proto->getName()
+                << " of type " << proto->getType() << std::endl;
             return nullptr;
         }
 
         if (m_CurrentToken.token != tok_sc) {
-            std::cerr << "Expected ';' at the end of the expression line: "
+            Logger::stream() << "Expected ';' at the end of the expression line: "
                 << m_Lexer->getLineCount() << std::endl;
             return nullptr;
         }
@@ -292,7 +426,7 @@ std::shared_ptr<FunctionDefinitionAST> Parser::parseDefinition(std::shared_ptr<P
         m_CurrentToken = waitForToken();
 
         if (m_CurrentToken.token != tok_bclose) {
-            std::cerr << "Expected '}' at the end of the definition got: "
+            Logger::stream() << "Expected '}' at the end of the definition got: "
                 << tokToString(m_CurrentToken.token) << std::endl;
             return nullptr;
         }
@@ -304,7 +438,7 @@ std::shared_ptr<FunctionDefinitionAST> Parser::parseDefinition(std::shared_ptr<P
 
     if (m_CurrentToken.token != tok_bclose) {
 
-        std::cerr << "Expected '}' at the end of the definition" << std::endl;
+        Logger::stream() << "Expected '}' at the end of the definition" << std::endl;
 
         return nullptr;
     }
@@ -312,10 +446,356 @@ std::shared_ptr<FunctionDefinitionAST> Parser::parseDefinition(std::shared_ptr<P
     return std::make_shared<FunctionDefinitionAST>(proto, std::move(blocks));
 }
 
+// Parses a statement of a function body, the current token is then the one
+// following its ';' or '}'.
+std::shared_ptr<ExprAST> Parser::parseStatement(const std::string &scope) {
+    std::shared_ptr<ExprAST> statement;
+
+    switch (m_CurrentToken.token) {
+        case tok_for:
+            return parseFor(scope);
+        case tok_while:
+            return parseWhile(scope);
+        case tok_parallel:
+            return parseParallelFor(scope);
+        case tok_if:
+            return parseIf(scope);
+        case tok_return:
+            statement = parseReturn(scope);
+            break;
+        case tok_type:
+            statement = parseDeclaration(scope);
+            break;
+        default:
+            statement = parseSimpleStatement(scope);
+            break;
+    }
+
+    if (!statement) {
+        return nullptr;
+    }
+
+    if (m_CurrentToken.token != tok_sc) {
+        Logger::stream() << "Expected ';' at the end of the statement line: "
+            << m_Lexer->getLineCount() << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    return statement;
+}
+
+// An expression or an assignment `name = expression`, without its ';'.
+std::shared_ptr<ExprAST> Parser::parseSimpleStatement(const std::string &scope) {
+    auto expr = parseExpression(scope);
+
+    if (!expr || m_CurrentToken.token != tok_eq) {
+        return expr;
+    }
+
+    auto variable = std::dynamic_pointer_cast<VariableExprAST>(expr);
+
+    if (!variable) {
+        Logger::stream() << "Only variables can be assigned" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    auto value = parseExpression(scope);
+
+    if (!value) {
+        return nullptr;
+    }
+
+    value = convertLiteral(std::move(value), variable->getType());
+
+    if (value->getType() != variable->getType()) {
+        Logger::stream() << "Cannot assign a " << value->getType() << " to " << variable->getIdentifier()
+            << " of type " << variable->getType() << ", use " << variable->getType() << "(...)" << std::endl;
+        return nullptr;
+    }
+
+    auto assign = std::make_shared<AssignExprAST>(variable->getIdentifier(), std::move(value));
+    assign->setLocation(variable->getLine(), variable->getColumn());
+
+    return assign;
+}
+
+// { statements }, the current token is then the one following the '}'.
+bool Parser::parseBlock(const std::string &scope, std::vector<std::shared_ptr<ExprAST>> &statements) {
+    if (m_CurrentToken.token != tok_bopen) {
+        Logger::stream() << "Expected '{' at the beginning of a block" << std::endl;
+        return false;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    while (m_CurrentToken.token != tok_bclose) {
+        if (m_CurrentToken.token == tok_eof) {
+            Logger::stream() << "Expected '}' at the end of the block" << std::endl;
+            return false;
+        }
+
+        auto statement = parseStatement(scope);
+
+        if (!statement) {
+            return false;
+        }
+
+        statements.push_back(std::move(statement));
+    }
+
+    m_CurrentToken = waitForToken();
+
+    return true;
+}
+
+std::shared_ptr<ExprAST> Parser::parseCondition(const std::string &scope) {
+    auto condition = parseExpression(scope);
+
+    if (condition && vectorWidth(condition->getType()) != 0) {
+        Logger::stream() << "A condition must be a scalar" << std::endl;
+        return nullptr;
+    }
+
+    return condition;
+}
+
+// for (init; condition; step) { body }
+std::shared_ptr<ExprAST> Parser::parseFor(const std::string &scope) {
+    Token forToken = m_CurrentToken;
+
+    m_CurrentToken = waitForToken();
+
+    if (m_CurrentToken.token != tok_popen) {
+        Logger::stream() << "Expected '(' after 'for'" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    auto init = parseStatement(scope);
+
+    if (!init) {
+        return nullptr;
+    }
+
+    auto condition = parseCondition(scope);
+
+    if (!condition) {
+        return nullptr;
+    }
+
+    if (m_CurrentToken.token != tok_sc) {
+        Logger::stream() << "Expected ';' after the loop condition" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    auto step = parseSimpleStatement(scope);
+
+    if (!step) {
+        return nullptr;
+    }
+
+    if (m_CurrentToken.token != tok_pclose) {
+        Logger::stream() << "Expected ')' after the loop step" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    std::vector<std::shared_ptr<ExprAST>> body;
+
+    if (!parseBlock(scope, body)) {
+        return nullptr;
+    }
+
+    auto loop = std::make_shared<ForExprAST>(std::move(init), std::move(condition), std::move(step), std::move(body));
+    loop->setLocation(forToken.line, forToken.column);
+
+    return loop;
+}
+
+// while (condition) { body }
+std::shared_ptr<ExprAST> Parser::parseWhile(const std::string &scope) {
+    Token whileToken = m_CurrentToken;
+
+    m_CurrentToken = waitForToken();
+
+    if (m_CurrentToken.token != tok_popen) {
+        Logger::stream() << "Expected '(' after 'while'" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    auto condition = parseCondition(scope);
+
+    if (!condition) {
+        return nullptr;
+    }
+
+    if (m_CurrentToken.token != tok_pclose) {
+        Logger::stream() << "Expected ')' after the loop condition" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    std::vector<std::shared_ptr<ExprAST>> body;
+
+    if (!parseBlock(scope, body)) {
+        return nullptr;
+    }
+
+    auto loop = std::make_shared<WhileExprAST>(std::move(condition), std::move(body));
+    loop->setLocation(whileToken.line, whileToken.column);
+
+    return loop;
+}
+
+// parallel for (type i = begin; i < end; i = i + 1) { body }, only counted
+// loops over an integer can be split between threads.
+std::shared_ptr<ExprAST> Parser::parseParallelFor(const std::string &scope) {
+    Token parallelToken = m_CurrentToken;
+
+    m_CurrentToken = waitForToken();
+
+    if (m_CurrentToken.token != tok_for) {
+        Logger::stream() << "Expected 'for' after 'parallel'" << std::endl;
+        return nullptr;
+    }
+
+    auto loop = std::dynamic_pointer_cast<ForExprAST>(parseFor(scope));
+
+    if (!loop) {
+        return nullptr;
+    }
+
+    auto init = std::dynamic_pointer_cast<VariableDefinitionAST>(loop->getInit());
+    auto condition = std::dynamic_pointer_cast<BinaryOpExprAST>(loop->getCondition());
+    auto step = std::dynamic_pointer_cast<AssignExprAST>(loop->getStep());
+
+    auto isVariable = [&](const std::shared_ptr<ExprAST> &expr) {
+        auto variable = std::dynamic_pointer_cast<VariableExprAST>(expr);
+        return variable && variable->getIdentifier() == init->getName();
+    };
+
+    auto isIncrement = [&]() {
+        auto increment = std::dynamic_pointer_cast<BinaryOpExprAST>(step->getValue());
+        auto one = increment ? std::dynamic_pointer_cast<IntExprAST>(increment->getRHS()) : nullptr;
+        return one && increment->getOp() == '+' && isVariable(increment->getLHS()) && one->getValue().ival == 1;
+    };
+
+    if (!init || !isIntegerType(init->getType()) || !condition || condition->getOp() != '<'
+        || !isVariable(condition->getLHS()) || !step || step->getName() != init->getName() || !isIncrement()) {
+        Logger::stream() << "A parallel for must have the form 'for (int i = begin; i < end; i = i + 1)', line: "
+            << parallelToken.line << std::endl;
+        return nullptr;
+    }
+
+    auto parallelLoop = std::make_shared<ParallelForExprAST>(init->getName(), init->getType(), init->getValue(),
+                                                             condition->getRHS(), loop->getBody());
+    parallelLoop->setLocation(parallelToken.line, parallelToken.column);
+
+    return parallelLoop;
+}
+
+// if (condition) { then } else { else }, else if chains nest in the else body.
+std::shared_ptr<ExprAST> Parser::parseIf(const std::string &scope) {
+    Token ifToken = m_CurrentToken;
+
+    m_CurrentToken = waitForToken();
+
+    if (m_CurrentToken.token != tok_popen) {
+        Logger::stream() << "Expected '(' after 'if'" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    auto condition = parseCondition(scope);
+
+    if (!condition) {
+        return nullptr;
+    }
+
+    if (m_CurrentToken.token != tok_pclose) {
+        Logger::stream() << "Expected ')' after the condition" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    std::vector<std::shared_ptr<ExprAST>> thenBody;
+    std::vector<std::shared_ptr<ExprAST>> elseBody;
+
+    if (!parseBlock(scope, thenBody)) {
+        return nullptr;
+    }
+
+    if (m_CurrentToken.token == tok_else) {
+        m_CurrentToken = waitForToken();
+
+        if (m_CurrentToken.token == tok_if) {
+            auto elseIf = parseIf(scope);
+
+            if (!elseIf) {
+                return nullptr;
+            }
+
+            elseBody.push_back(std::move(elseIf));
+        } else if (!parseBlock(scope, elseBody)) {
+            return nullptr;
+        }
+    }
+
+    auto ifExpr = std::make_shared<IfExprAST>(std::move(condition), std::move(thenBody), std::move(elseBody));
+    ifExpr->setLocation(ifToken.line, ifToken.column);
+
+    return ifExpr;
+}
+
+// return expression, without its ';'. The last return of a body is parsed by
+// parseDefinition.
+std::shared_ptr<ExprAST> Parser::parseReturn(const std::string &scope) {
+    Token returnToken = m_CurrentToken;
+
+    m_CurrentToken = waitForToken();
+
+    auto value = parseExpression(scope);
+
+    if (!value) {
+        Logger::stream() << "Expecting expression after 'return'!" << std::endl;
+        return nullptr;
+    }
+
+    // scope is the name of the function.
+    const std::string &returnType = m_NameType[scope];
+    value = convertLiteral(std::move(value), returnType);
+
+    if (value->getType() != returnType) {
+        Logger::stream() << "Cannot return a " << value->getType() << " from " << scope
+            << " of type " << returnType << std::endl;
+        return nullptr;
+    }
+
+    auto returnExpr = std::make_shared<ReturnExprAST>(std::move(value));
+    returnExpr->setLocation(returnToken.line, returnToken.column);
+
+    return returnExpr;
+}
+
+// An expression, or the assignment of a global variable.
 std::shared_ptr<ExprAST> Parser::parseTopLevelExpr() {
-    if (auto expr = parseExpression()) {
+    if (auto expr = parseSimpleStatement("")) {
 
-        auto declaration = std::make_shared<DeclarationAST>(expr->getType(), std::to_string(m_AnonFuncNum));
+        auto declaration = std::make_shared<DeclarationAST>(expr->getType(), anonFunctionName(m_AnonFuncNum++));
+        declaration->setLocation(expr->getLine(), expr->getColumn());
         auto proto = std::make_shared<PrototypeAST>(std::move(declaration),
                                                     std::vector<std::shared_ptr<DeclarationAST>>());
 
@@ -336,12 +816,20 @@ std::shared_ptr<ExprAST> Parser::parseIdentifier(const std::string &scope) {
 
     auto it = m_NameType.find(scopedId);
 
+    // Functions are declared globally.
     if (it == m_NameType.end()) {
-        std::cerr << "Variable or function called but not declared: " << scopedId << std::endl;
+        it = m_NameType.find(identifier);
+    }
+
+    bool isBuiltin = it == m_NameType.end() && (isReduction(identifier) || isMathBuiltin(identifier)) &&
+        m_CurrentToken.token == tok_popen;
+
+    if (it == m_NameType.end() && !isBuiltin) {
+        Logger::stream() << "Variable or function called but not declared: " << scopedId << std::endl;
         return nullptr;
     }
 
-    std::string type = it->second;
+    std::string type = isBuiltin ? "" : it->second;
 
     if (m_CurrentToken.token != tok_popen){
 
@@ -367,20 +855,96 @@ std::shared_ptr<ExprAST> Parser::parseIdentifier(const std::string &scope) {
 
             if (m_CurrentToken.token != tok_comma) {
                 m_CurrentToken = waitForToken();
-                std::cerr << "Expected ')' or ',' in argument list" << std::endl;
+                Logger::stream() << "Expected ')' or ',' in argument list" << std::endl;
                 return nullptr;
             }
 
             m_CurrentToken = waitForToken();
         }
 
+    } else {
+        m_CurrentToken = waitForToken();
+    }
+
+    auto paramTypes = m_ParamTypes.find(identifier);
+
+    if (!isBuiltin && paramTypes != m_ParamTypes.end()) {
+        if (paramTypes->second.size() != args.size()) {
+            Logger::stream() << identifier << "() expects " << paramTypes->second.size() << " arguments, got "
+                << args.size() << std::endl;
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < args.size(); i++) {
+            args[i] = convertLiteral(std::move(args[i]), paramTypes->second[i]);
+
+            if (args[i]->getType() != paramTypes->second[i]) {
+                Logger::stream() << "Argument " << i + 1 << " of " << identifier << "() must be a "
+                    << paramTypes->second[i] << ", got " << args[i]->getType() << std::endl;
+                return nullptr;
+            }
+        }
+    }
+
+    // Reductions return the element type of their vector argument.
+    if (isBuiltin && isReduction(identifier) && args.size() == 1) {
+        if (vectorWidth(args[0]->getType()) == 0) {
+            Logger::stream() << identifier << "() expects a single vector argument" << std::endl;
+            return nullptr;
+        }
+
+        type = elementType(args[0]->getType());
+    } else if (isBuiltin) {
+        if (!parseMathBuiltinArgs(identifier, args)) {
+            return nullptr;
+        }
+
+        type = args[0]->getType();
     }
 
     return std::make_shared<CallFunctionExprAST>(type, identifier, std::move(args));
 }
 
+// Math builtins apply element-wise to arguments of one type, floating point
+// except for min and max.
+bool Parser::parseMathBuiltinArgs(const std::string &name, std::vector<std::shared_ptr<ExprAST>> &args) {
+    if (args.size() != mathBuiltinArity(name)) {
+        Logger::stream() << name << "() expects " << mathBuiltinArity(name) << " arguments, got " << args.size()
+            << std::endl;
+        return false;
+    }
+
+    // Literals take the type of the other arguments.
+    std::string type = args[0]->getType();
+    for (const auto &arg : args) {
+        if (!std::dynamic_pointer_cast<NumberExprAST>(arg)) {
+            type = arg->getType();
+            break;
+        }
+    }
+
+    for (auto &arg : args) {
+        arg = convertLiteral(std::move(arg), type);
+    }
+
+    for (const auto &arg : args) {
+        if (arg->getType() != args[0]->getType()) {
+            Logger::stream() << "The arguments of " << name << "() must have the same type, got "
+                << args[0]->getType() << " and " << arg->getType() << std::endl;
+            return false;
+        }
+    }
+
+    if (name != "min" && name != "max" && !isFloatType(args[0]->getType())) {
+        Logger::stream() << name << "() expects floating point arguments, got " << args[0]->getType() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 std::shared_ptr<IntExprAST> Parser::parseIntExpr() {
-    int val = std::stoi(m_CurrentToken.valueStr);
+    int64_t val = std::stoll(m_CurrentToken.valueStr);
     m_CurrentToken = waitForToken();
     return std::make_shared<IntExprAST>(val);
 }
@@ -398,7 +962,7 @@ std::shared_ptr<ExprAST> Parser::parseParensExpr(const std::string &scope) {
         return nullptr;
 
     if (m_CurrentToken.token != tok_pclose) {
-        std::cerr << "Expected ')'" << std::endl;
+        Logger::stream() << "Expected ')'" << std::endl;
     }
 
     m_CurrentToken = waitForToken();
@@ -406,13 +970,112 @@ std::shared_ptr<ExprAST> Parser::parseParensExpr(const std::string &scope) {
     return expr;
 }
 
+std::shared_ptr<ExprAST> Parser::parseVectorExpr(const std::string &scope) {
+    m_CurrentToken = waitForToken();
+
+    std::vector<std::shared_ptr<ExprAST>> elements;
+
+    while (m_CurrentToken.token != ']') {
+        auto element = parseExpression(scope);
+
+        if (!element) {
+            return nullptr;
+        }
+
+        if (vectorWidth(element->getType()) != 0) {
+            Logger::stream() << "Vector elements must be scalars" << std::endl;
+            return nullptr;
+        }
+
+        if (!elements.empty()) {
+            element = convertLiteral(std::move(element), elements[0]->getType());
+        }
+
+        if (!elements.empty() && element->getType() != elements[0]->getType()) {
+            Logger::stream() << "Vector elements must all be of type " << elements[0]->getType() << std::endl;
+            return nullptr;
+        }
+
+        elements.push_back(std::move(element));
+
+        if (m_CurrentToken.token == tok_comma) {
+            m_CurrentToken = waitForToken();
+        } else if (m_CurrentToken.token != ']') {
+            Logger::stream() << "Expected ']' or ',' in vector" << std::endl;
+            return nullptr;
+        }
+    }
+
+    m_CurrentToken = waitForToken();
+
+    if (elements.empty()) {
+        Logger::stream() << "Vectors cannot be empty" << std::endl;
+        return nullptr;
+    }
+
+    std::string type = vectorType(elements[0]->getType(), elements.size());
+
+    return std::make_shared<VectorExprAST>(type, std::move(elements));
+}
+
 std::shared_ptr<ExprAST> Parser::parseExpression(const std::string &scope) {
     auto LHS = parsePrimaryExpr(scope);
 
     if (!LHS)
         return nullptr;
 
-    return parseBinaryExpr(0, std::move(LHS), scope);
+    auto expr = parseBinaryExpr(0, std::move(LHS), scope);
+
+    if (!expr || m_CurrentToken.token != '?') {
+        return expr;
+    }
+
+    return parseConditional(std::move(expr), scope);
+}
+
+// condition ? then : else, binds looser than every binary operator.
+std::shared_ptr<ExprAST> Parser::parseConditional(std::shared_ptr<ExprAST> condition, const std::string &scope) {
+    Token questionToken = m_CurrentToken;
+
+    if (vectorWidth(condition->getType()) != 0) {
+        Logger::stream() << "A condition must be a scalar" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    auto thenExpr = parseExpression(scope);
+
+    if (!thenExpr) {
+        return nullptr;
+    }
+
+    if (m_CurrentToken.token != ':') {
+        Logger::stream() << "Expected ':' in conditional expression" << std::endl;
+        return nullptr;
+    }
+
+    m_CurrentToken = waitForToken();
+
+    auto elseExpr = parseExpression(scope);
+
+    if (!elseExpr) {
+        return nullptr;
+    }
+
+    elseExpr = convertLiteral(std::move(elseExpr), thenExpr->getType());
+    thenExpr = convertLiteral(std::move(thenExpr), elseExpr->getType());
+
+    if (thenExpr->getType() != elseExpr->getType()) {
+        Logger::stream() << "Both sides of a conditional expression must have the same type, got "
+            << thenExpr->getType() << " and " << elseExpr->getType() << std::endl;
+        return nullptr;
+    }
+
+    auto conditional = std::make_shared<ConditionalExprAST>(std::move(condition), std::move(thenExpr), std::move(elseExpr));
+    conditional->setLocation(questionToken.line, questionToken.column);
+
+    return conditional;
 }
 
 std::shared_ptr<ExprAST> Parser::parsePrimaryExpr(const std::string &scope) {
@@ -420,20 +1083,116 @@ std::shared_ptr<ExprAST> Parser::parsePrimaryExpr(const std::string &scope) {
         m_CurrentToken = waitForToken();
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+
+    Token startToken = m_CurrentToken;
+    std::shared_ptr<ExprAST> expr;
+
     switch (m_CurrentToken.token) {
         case tok_identifier:
-            return parseIdentifier(scope);
+            expr = parseIdentifier(scope);
+            break;
         case tok_val_float:
-            return parseFloatExpr();
+            expr = parseFloatExpr();
+            break;
         case tok_val_int:
-            return parseIntExpr();
+            expr = parseIntExpr();
+            break;
         case tok_popen:
+            // Keep the location of the inner expression.
             return parseParensExpr(scope);
+        case '[':
+            expr = parseVectorExpr(scope);
+            break;
+        case tok_type:
+            expr = parseCast(scope);
+            break;
         default:
-            std::cerr << "Unexpected token instead of expression : " << tokToString(m_CurrentToken.token) << std::endl;
+            Logger::stream() << "Unexpected token instead of expression : " << tokToString(m_CurrentToken.token)
+                << std::endl;
             m_CurrentToken = waitForToken();
             return nullptr;
     }
+
+    if (expr) {
+        expr->setLocation(startToken.line, startToken.column);
+    }
+
+    return expr;
+}
+
+// type(expression), the value is converted element-wise.
+std::shared_ptr<ExprAST> Parser::parseCast(const std::string &scope) {
+    std::string type = m_CurrentToken.identifier;
+
+    m_CurrentToken = waitForToken();
+
+    if (m_CurrentToken.token != tok_popen) {
+        Logger::stream() << "Expected '(' after " << type << " in a conversion" << std::endl;
+        return nullptr;
+    }
+
+    auto value = parseParensExpr(scope);
+
+    if (!value) {
+        return nullptr;
+    }
+
+    if (vectorWidth(value->getType()) != vectorWidth(type)) {
+        Logger::stream() << "Cannot convert a " << value->getType() << " to " << type << std::endl;
+        return nullptr;
+    }
+
+    return std::make_shared<CastExprAST>(type, std::move(value));
+}
+
+// Numeric literals have no type of their own: an integer literal takes any
+// integer element type and a floating literal any floating one. Other
+// expressions are returned as is.
+std::shared_ptr<ExprAST> Parser::convertLiteral(std::shared_ptr<ExprAST> expr, const std::string &type) {
+    std::string element = elementType(type);
+
+    if (elementType(expr->getType()) == element) {
+        return expr;
+    }
+
+    std::shared_ptr<ExprAST> converted;
+
+    if (auto literal = std::dynamic_pointer_cast<IntExprAST>(expr)) {
+        if (isIntegerType(element)) {
+            converted = std::make_shared<IntExprAST>(literal->getValue().ival, element);
+        }
+    } else if (auto literal = std::dynamic_pointer_cast<FloatExprAST>(expr)) {
+        if (isFloatType(element)) {
+            converted = std::make_shared<FloatExprAST>(literal->getValue().fval, element);
+        }
+    } else if (auto vector = std::dynamic_pointer_cast<VectorExprAST>(expr)) {
+        std::vector<std::shared_ptr<ExprAST>> elements;
+
+        for (const auto &e : vector->getElements()) {
+            elements.push_back(convertLiteral(e, element));
+
+            if (elements.back()->getType() != element) {
+                return expr;
+            }
+        }
+
+        converted = std::make_shared<VectorExprAST>(vectorType(element, elements.size()), std::move(elements));
+    } else if (auto binary = std::dynamic_pointer_cast<BinaryOpExprAST>(expr)) {
+        auto LHS = convertLiteral(binary->getLHS(), element);
+        auto RHS = convertLiteral(binary->getRHS(), element);
+
+        if (elementType(LHS->getType()) == element && elementType(RHS->getType()) == element) {
+            converted = std::make_shared<BinaryOpExprAST>(binary->getOp(), std::move(LHS), std::move(RHS));
+        }
+    }
+
+    if (!converted) {
+        return expr;
+    }
+
+    converted->setLocation(expr->getLine(), expr->getColumn());
+
+    return converted;
 }
 
 std::shared_ptr<ExprAST> Parser::parseBinaryExpr(int exprPrec, std::shared_ptr<ExprAST> LHS, const std::string &scope) {
@@ -444,6 +1203,7 @@ std::shared_ptr<ExprAST> Parser::parseBinaryExpr(int exprPrec, std::shared_ptr<E
         }
 
         int binOp = m_CurrentToken.token;
+        Token opToken = m_CurrentToken;
 
         m_CurrentToken = waitForToken();
 
@@ -462,38 +1222,44 @@ std::shared_ptr<ExprAST> Parser::parseBinaryExpr(int exprPrec, std::shared_ptr<E
             }
         }
 
+        // A literal takes the element type of the other operand.
+        RHS = convertLiteral(std::move(RHS), elementType(LHS->getType()));
+        LHS = convertLiteral(std::move(LHS), elementType(RHS->getType()));
+
+        if (elementType(LHS->getType()) != elementType(RHS->getType())) {
+            Logger::stream() << "Mismatched operand types " << LHS->getType() << " and " << RHS->getType()
+                << ", convert one with type(...)" << std::endl;
+            return nullptr;
+        }
+
         LHS = std::make_shared<BinaryOpExprAST>(binOp, std::move(LHS), std::move(RHS));
+        LHS->setLocation(opToken.line, opToken.column);
     }
 }
 
 std::shared_ptr<VariableDefinitionAST>
-Parser::parseVariableDefinition(std::shared_ptr<DeclarationAST> declarationAST) {
+Parser::parseVariableDefinition(std::shared_ptr<DeclarationAST> declarationAST, const std::string &scope) {
     m_CurrentToken = waitForToken();
-    std::shared_ptr<NumberExprAST> value;
 
-    if (m_CurrentToken.token == tok_val_int) {
-        if (declarationAST->getType() == "float") {
-            std::cerr << "Expected a float got an int, cast not implemented yet!!" << std::endl;
-            return nullptr;
-        }
-        value = parseIntExpr();
-        return std::make_shared<VariableDefinitionAST>(declarationAST->getType(), declarationAST->getName(), value);
-    }
+    auto value = parseExpression(scope);
 
-    if (m_CurrentToken.token == tok_val_float) {
-        if (declarationAST->getType() == "int") {
-            std::cerr << "Expected an int got a float, cast not implemented yet!!" << std::endl;
-            return nullptr;
-        }
-        value = parseFloatExpr();
-        return std::make_shared<VariableDefinitionAST>(declarationAST->getType(), declarationAST->getName(), value);
+    if (!value) {
+        Logger::stream() << "Expected a value for " << declarationAST->getName() << std::endl;
+        return nullptr;
     }
 
-    std::cerr << "Unexpected token: " << tokToString(m_CurrentToken.token) <<
-              " when expected " << declarationAST->getType() << std::endl;
+    value = convertLiteral(std::move(value), declarationAST->getType());
 
-    return nullptr;
+    if (value->getType() != declarationAST->getType()) {
+        Logger::stream() << "Expected " << declarationAST->getType() << " got " << value->getType()
+            << ", use " << declarationAST->getType() << "(...)" << std::endl;
+        return nullptr;
+    }
+
+    auto definition = std::make_shared<VariableDefinitionAST>(declarationAST->getType(), declarationAST->getName(), value);
+    definition->setLocation(declarationAST->getLine(), declarationAST->getColumn());
 
+    return definition;
 }
 
 Parser::~Parser() {
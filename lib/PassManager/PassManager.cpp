@@ -2,18 +2,72 @@
 
 #include "PassManager/PassManager.hpp"
 
-PassManager::PassManager(llvm::Module* module)
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Utils.h>
+#include <llvm/Transforms/Vectorize.h>
+
+#include "Statistics/Statistics.hpp"
+
+YAPL_STATISTIC(NumInstructionsBefore, "passes", "IR instructions before optimization");
+YAPL_STATISTIC(NumInstructionsAfter, "passes", "IR instructions after optimization");
+
+PassManager::PassManager(llvm::Module* module, llvm::TargetMachine *targetMachine)
+    : m_Module(module), m_TargetMachine(targetMachine)
 {
     m_FunctionPassManager = std::make_unique<llvm::legacy::FunctionPassManager>(module);
 
+    // Without the target's TTI, the vectorizers see no vector registers.
+    if (m_TargetMachine) {
+        m_FunctionPassManager->add(llvm::createTargetTransformInfoWrapperPass(m_TargetMachine->getTargetIRAnalysis()));
+    }
+
+    m_FunctionPassManager->add(llvm::createPromoteMemoryToRegisterPass());
     m_FunctionPassManager->add(llvm::createInstructionCombiningPass());
     m_FunctionPassManager->add(llvm::createReassociatePass());
     m_FunctionPassManager->add(llvm::createGVNPass());
     m_FunctionPassManager->add(llvm::createCFGSimplificationPass());
 
+    // Self-recursive tail calls become loops, optimized as such below.
+    m_FunctionPassManager->add(llvm::createTailCallEliminationPass());
+
+    // Loops are rotated and their induction variables canonicalized for the
+    // loop vectorizer, the SLP vectorizer then packs the straight-line code.
+    m_FunctionPassManager->add(llvm::createLoopRotatePass());
+    m_FunctionPassManager->add(llvm::createLICMPass());
+    m_FunctionPassManager->add(llvm::createIndVarSimplifyPass());
+    m_FunctionPassManager->add(llvm::createLoopVectorizePass());
+    m_FunctionPassManager->add(llvm::createSLPVectorizerPass());
+    m_FunctionPassManager->add(llvm::createInstructionCombiningPass());
+    m_FunctionPassManager->add(llvm::createCFGSimplificationPass());
+
     m_FunctionPassManager->doInitialization();
 }
 
 void PassManager::run(llvm::Function &function){
+    NumInstructionsBefore += function.getInstructionCount();
     m_FunctionPassManager->run(function);
+    NumInstructionsAfter += function.getInstructionCount();
+}
+
+void PassManager::runVectorizer() {
+    llvm::legacy::PassManager modulePassManager;
+
+    if (m_TargetMachine) {
+        modulePassManager.add(llvm::createTargetTransformInfoWrapperPass(m_TargetMachine->getTargetIRAnalysis()));
+    }
+
+    llvm::PassManagerBuilder builder;
+    builder.OptLevel = 3;
+    builder.Inliner = llvm::createFunctionInliningPass(builder.OptLevel, 0, false);
+    builder.LoopVectorize = true;
+    builder.SLPVectorize = true;
+
+    if (m_TargetMachine) {
+        m_TargetMachine->adjustPassManager(builder);
+    }
+
+    builder.populateModulePassManager(modulePassManager);
+    modulePassManager.run(*m_Module);
 }
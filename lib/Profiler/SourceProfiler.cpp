@@ -0,0 +1,206 @@
+#include "Profiler/SourceProfiler.hpp"
+
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/Error.h>
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <vector>
+
+// Written from the signal handler, must stay async-signal-safe.
+static constexpr size_t s_MaxSamples = 1 << 20;
+static std::unique_ptr<uint64_t[]> s_Samples;
+static std::atomic<size_t> s_SampleCount{0};
+
+static uint64_t getProgramCounter(void *context) {
+    auto *userContext = static_cast<ucontext_t *>(context);
+#if defined(__linux__) && defined(__x86_64__)
+    return static_cast<uint64_t>(userContext->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__linux__) && defined(__aarch64__)
+    return static_cast<uint64_t>(userContext->uc_mcontext.pc);
+#elif defined(__APPLE__) && defined(__x86_64__)
+    return static_cast<uint64_t>(userContext->uc_mcontext->__ss.__rip);
+#elif defined(__APPLE__) && defined(__aarch64__)
+    return static_cast<uint64_t>(userContext->uc_mcontext->__ss.__pc);
+#else
+    (void)userContext;
+    return 0;
+#endif
+}
+
+static void handleSample(int, siginfo_t *, void *context) {
+    size_t index = s_SampleCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (index < s_MaxSamples) {
+        s_Samples[index] = getProgramCounter(context);
+    }
+}
+
+SourceProfiler::~SourceProfiler() {
+    stop();
+}
+
+void SourceProfiler::notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                                        const llvm::RuntimeDyld::LoadedObjectInfo &loadedObject) {
+    // The debug object has its sections, DWARF included, at their load addresses.
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debugObjectOwner = loadedObject.getObjectForDebug(object);
+    const llvm::object::ObjectFile *debugObject = debugObjectOwner.getBinary();
+
+    if (!debugObject) {
+        return;
+    }
+
+    auto context = llvm::DWARFContext::create(*debugObject);
+
+    std::lock_guard lock{m_Mutex};
+
+    for (const auto &symbolAndSize : llvm::object::computeSymbolSizes(*debugObject)) {
+        const llvm::object::SymbolRef &symbol = symbolAndSize.first;
+
+        auto typeOrErr = symbol.getType();
+        if (!typeOrErr) {
+            llvm::consumeError(typeOrErr.takeError());
+            continue;
+        }
+
+        if (*typeOrErr != llvm::object::SymbolRef::ST_Function) {
+            continue;
+        }
+
+        auto nameOrErr = symbol.getName();
+        auto addressOrErr = symbol.getAddress();
+        auto sectionOrErr = symbol.getSection();
+
+        if (!nameOrErr || !addressOrErr || !sectionOrErr) {
+            llvm::consumeError(nameOrErr.takeError());
+            llvm::consumeError(addressOrErr.takeError());
+            llvm::consumeError(sectionOrErr.takeError());
+            continue;
+        }
+
+        uint64_t address = *addressOrErr;
+        uint64_t size = symbolAndSize.second;
+
+        m_Functions[address] = FunctionRange{ address + size, nameOrErr->str() };
+
+        llvm::object::SectionedAddress sectionedAddress{ address, (*sectionOrErr)->getIndex() };
+        for (const auto &row : context->getLineInfoForAddressRange(sectionedAddress, size)) {
+            m_Lines[row.first] = LineEntry{ row.second.FileName, row.second.Line };
+        }
+    }
+}
+
+bool SourceProfiler::start(unsigned intervalMicroseconds) {
+    if (m_Running) {
+        return true;
+    }
+
+    if (!s_Samples) {
+        s_Samples = std::make_unique<uint64_t[]>(s_MaxSamples);
+    }
+
+    struct sigaction action = {};
+    action.sa_sigaction = handleSample;
+    // SA_RESTART: the lexer's blocking reads must not see EINTR.
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+        std::perror("Failed to install the profiler signal handler");
+        return false;
+    }
+
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = intervalMicroseconds / 1000000;
+    timer.it_interval.tv_usec = intervalMicroseconds % 1000000;
+    timer.it_value = timer.it_interval;
+
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        std::perror("Failed to start the profiler timer");
+        return false;
+    }
+
+    m_Running = true;
+    return true;
+}
+
+void SourceProfiler::stop() {
+    if (!m_Running) {
+        return;
+    }
+
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    std::signal(SIGPROF, SIG_IGN);
+
+    m_Running = false;
+}
+
+void SourceProfiler::printReport(std::ostream &stream, size_t maxLines) const {
+    std::lock_guard lock{m_Mutex};
+
+    size_t sampleCount = std::min(s_SampleCount.load(), s_MaxSamples);
+    size_t jitSamples = 0;
+
+    std::map<std::pair<std::string, unsigned>, std::pair<size_t, std::string>> hotLines;
+
+    for (size_t i = 0; i < sampleCount; i++) {
+        uint64_t pc = s_Samples[i];
+
+        auto function = m_Functions.upper_bound(pc);
+        if (function == m_Functions.begin()) {
+            continue;
+        }
+        --function;
+        if (pc >= function->second.end) {
+            continue;
+        }
+
+        jitSamples++;
+
+        std::pair<std::string, unsigned> location{ "<unknown>", 0 };
+        auto line = m_Lines.upper_bound(pc);
+        if (line != m_Lines.begin()) {
+            --line;
+            if (line->first >= function->first) {
+                location = { line->second.file, line->second.line };
+            }
+        }
+
+        auto &hotLine = hotLines[location];
+        hotLine.first++;
+        hotLine.second = function->second.name;
+    }
+
+    std::vector<std::pair<std::pair<std::string, unsigned>, std::pair<size_t, std::string>>> sorted(
+            hotLines.begin(), hotLines.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.second.first > rhs.second.first;
+    });
+
+    stream << "===------------------ YAPL profile ------------------===" << std::endl;
+    stream << sampleCount << " samples, " << jitSamples << " in JIT compiled code" << std::endl;
+
+    if (jitSamples == 0) {
+        return;
+    }
+
+    stream << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < sorted.size() && i < maxLines; i++) {
+        const auto &location = sorted[i].first;
+        const auto &count = sorted[i].second;
+
+        stream << std::setw(6) << 100.0 * count.first / jitSamples << "% "
+            << std::setw(8) << count.first << "  "
+            << location.first << ":" << location.second
+            << "  (" << count.second << ")" << std::endl;
+    }
+    stream << std::defaultfloat;
+}
@@ -0,0 +1,151 @@
+#include "Runtime/ParallelRuntime.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "Statistics/Statistics.hpp"
+
+YAPL_STATISTIC(NumParallelLoopsRun, "runtime", "Parallel loops run");
+YAPL_STATISTIC(NumChunksRun, "runtime", "Parallel loop chunks run");
+YAPL_STATISTIC(NumChunksStolen, "runtime", "Parallel loop chunks stolen from another queue");
+
+// Chunks per thread: enough for stealing to even out unbalanced iterations.
+static constexpr int64_t s_ChunksPerThread = 8;
+
+// Queue of the current thread, -1 outside of the pool.
+static thread_local int t_QueueIndex = -1;
+
+ParallelRuntime::ParallelRuntime(unsigned workers) {
+    for (unsigned i = 0; i < workers; i++) {
+        m_Queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (unsigned i = 0; i < workers; i++) {
+        m_Workers.emplace_back(&ParallelRuntime::work, this, i);
+    }
+}
+
+ParallelRuntime::~ParallelRuntime() {
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Stop = true;
+    }
+    m_Wakeup.notify_all();
+
+    for (auto &worker : m_Workers) {
+        worker.join();
+    }
+}
+
+ParallelRuntime &ParallelRuntime::get() {
+    static ParallelRuntime runtime([]() {
+        if (const char *threads = std::getenv("YAPL_NUM_THREADS")) {
+            return std::max(1, std::atoi(threads));
+        }
+
+        return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }());
+
+    return runtime;
+}
+
+void ParallelRuntime::work(unsigned index) {
+    t_QueueIndex = index;
+
+    while (true) {
+        if (runOne(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
+        m_Wakeup.wait(lock, [this]() { return m_Stop || m_Queued > 0; });
+
+        if (m_Stop) {
+            return;
+        }
+    }
+}
+
+// Runs the newest chunk of the given queue, or else steals the oldest chunk
+// of another one. Returns false if every queue is empty.
+bool ParallelRuntime::runOne(int queue) {
+    Chunk chunk;
+    bool found = false;
+    int queues = m_Queues.size();
+
+    if (queue >= 0) {
+        Queue &own = *m_Queues[queue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            found = true;
+        }
+    }
+
+    for (int i = 1; i <= queues && !found; i++) {
+        Queue &victim = *m_Queues[(std::max(queue, 0) + i) % queues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            found = true;
+            ++NumChunksStolen;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    --m_Queued;
+    chunk.body(chunk.context, chunk.begin, chunk.end);
+    chunk.pending->fetch_sub(1, std::memory_order_release);
+    ++NumChunksRun;
+
+    return true;
+}
+
+void ParallelRuntime::parallelFor(int64_t begin, int64_t end, ParallelBody body, void *context) {
+    if (begin >= end) {
+        return;
+    }
+
+    ++NumParallelLoopsRun;
+
+    int64_t iterations = end - begin;
+    int64_t numChunks = std::min<int64_t>(iterations, getNumThreads() * s_ChunksPerThread);
+    int64_t chunkSize = (iterations + numChunks - 1) / numChunks;
+    numChunks = (iterations + chunkSize - 1) / chunkSize;
+
+    std::atomic<int64_t> pending{numChunks};
+
+    // Chunks are dealt in turn to every queue, starting with the caller's.
+    int first = std::max(t_QueueIndex, 0);
+    for (int64_t i = 0; i < numChunks; i++) {
+        Queue &queue = *m_Queues[(first + i) % m_Queues.size()];
+        int64_t chunkBegin = begin + i * chunkSize;
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        queue.chunks.push_back({body, context, chunkBegin, std::min(end, chunkBegin + chunkSize), &pending});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Queued += numChunks;
+    }
+    m_Wakeup.notify_all();
+
+    // The caller helps, possibly with chunks of other loops, until its loop is done.
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!runOne(t_QueueIndex)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+extern "C" void yapl_parallel_for(int64_t begin, int64_t end, ParallelBody body, void *context) {
+    ParallelRuntime::get().parallelFor(begin, end, body, context);
+}
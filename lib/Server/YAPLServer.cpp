@@ -0,0 +1,283 @@
+#include "Server/YAPLServer.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "IRGenerator/IRGenerator.hpp"
+#include "Lexer/Lexer.hpp"
+#include "Logger/Logger.hpp"
+#include "Statistics/Statistics.hpp"
+
+YAPL_STATISTIC(NumSessions, "server", "Client sessions served");
+YAPL_STATISTIC(NumActiveSessionsPeak, "server", "Peak client sessions served at once");
+
+static std::atomic<uint64_t> s_ActiveSessions{0};
+
+static llvm::Error makeSystemError(const std::string &message) {
+    return llvm::make_error<llvm::StringError>(message + ": " + std::strerror(errno),
+            llvm::inconvertibleErrorCode());
+}
+
+static bool getSocketAddress(const std::string &path, sockaddr_un &address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return true;
+}
+
+// Removes the socket left behind by a server that did not exit cleanly. Any
+// other file, or the socket of a running server, is an error.
+static llvm::Error removeStaleSocket(const std::string &path, const sockaddr_un &address) {
+    struct stat status;
+
+    if (lstat(path.c_str(), &status) < 0) {
+        return errno == ENOENT ? llvm::Error::success() : makeSystemError("Failed to check " + path);
+    }
+
+    if (!S_ISSOCK(status.st_mode)) {
+        return llvm::make_error<llvm::StringError>("Not a socket: " + path, llvm::inconvertibleErrorCode());
+    }
+
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (probe < 0) {
+        return makeSystemError("Failed to create the socket");
+    }
+
+    int result = connect(probe, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+    int connectError = errno;
+    close(probe);
+
+    if (result == 0) {
+        return llvm::make_error<llvm::StringError>("A server is already listening on " + path,
+                llvm::inconvertibleErrorCode());
+    }
+
+    if (connectError != ECONNREFUSED) {
+        errno = connectError;
+        return makeSystemError("Failed to check " + path);
+    }
+
+    if (unlink(path.c_str()) < 0) {
+        return makeSystemError("Failed to remove the stale socket " + path);
+    }
+
+    return llvm::Error::success();
+}
+
+static bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (written <= 0) {
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+YAPLServer::YAPLServer(const Options &options, std::string socketPath)
+    : m_Options(options), m_SocketPath(std::move(socketPath))
+{
+    // Sessions read their socket, as the REPL reads stdin.
+    m_Options.inputPath = "";
+}
+
+YAPLServer::~YAPLServer() {
+    if (m_Socket >= 0) {
+        close(m_Socket);
+        unlink(m_SocketPath.c_str());
+    }
+}
+
+llvm::Error YAPLServer::listen() {
+    // Written once per process, or not thread-safe.
+    if (m_Options.timeReport || m_Options.profile || !m_Options.emitBitcode.empty()) {
+        return llvm::make_error<llvm::StringError>(
+                "--time-report, --profile and --emit-bc are not supported by the server",
+                llvm::inconvertibleErrorCode());
+    }
+
+    auto jit = SharedJIT::Create(m_Options.jitLinker, true);
+
+    if (!jit) {
+        return jit.takeError();
+    }
+
+    m_JIT = std::move(*jit);
+
+    if (m_Options.perfMap && !m_JIT->enablePerfMap()) {
+        std::cerr << "--perf-map requires the RuntimeDyld linker" << std::endl;
+    }
+
+    if (m_Options.perfJitDump && !m_JIT->enablePerfJitDump()) {
+        std::cerr << "--perf-jitdump requires the RuntimeDyld linker and LLVM built with LLVM_USE_PERF" << std::endl;
+    }
+
+    if (m_Options.gdbJIT && !m_JIT->enableGDBRegistration()) {
+        std::cerr << "--gdb-jit requires the RuntimeDyld linker" << std::endl;
+    }
+
+    sockaddr_un address;
+
+    if (!getSocketAddress(m_SocketPath, address)) {
+        return llvm::make_error<llvm::StringError>("Socket path too long: " + m_SocketPath,
+                llvm::inconvertibleErrorCode());
+    }
+
+    if (auto error = removeStaleSocket(m_SocketPath, address)) {
+        return error;
+    }
+
+    m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (m_Socket < 0) {
+        return makeSystemError("Failed to create the socket");
+    }
+
+    if (bind(m_Socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        return makeSystemError("Failed to bind " + m_SocketPath);
+    }
+
+    if (::listen(m_Socket, SOMAXCONN) < 0) {
+        return makeSystemError("Failed to listen on " + m_SocketPath);
+    }
+
+    return llvm::Error::success();
+}
+
+void YAPLServer::serve() {
+    // A client closing its connection early must not kill the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cerr << "Listening on " << m_SocketPath << std::endl;
+
+    while (true) {
+        int connection = accept(m_Socket, nullptr, nullptr);
+
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            std::perror("Failed to accept a client");
+            return;
+        }
+
+        std::thread(&YAPLServer::runSession, this, connection).detach();
+    }
+}
+
+void YAPLServer::runSession(int connection) {
+    ++NumSessions;
+    NumActiveSessionsPeak.updateMax(++s_ActiveSessions);
+
+    std::FILE *input = fdopen(connection, "r");
+    std::FILE *output = fdopen(dup(connection), "w");
+
+    if (!input || !output) {
+        std::perror("Failed to open a client connection");
+    } else {
+        // Line buffered, the prompt is flushed explicitly.
+        std::setvbuf(output, nullptr, _IOLBF, 0);
+
+        LogOutput log(output);
+        Logger::setThreadOutput(&log);
+
+        IRGenerator generator(Lexer::fromStream(input), m_Options, m_JIT);
+        generator.generate();
+
+        Logger::setThreadOutput(nullptr);
+
+        // The session's JITDylib stays in the execution session, empty.
+        if (auto error = generator.clearJIT()) {
+            llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "Failed to free a session: ");
+        }
+    }
+
+    if (output) {
+        std::fclose(output);
+    }
+
+    if (input) {
+        std::fclose(input);
+    } else {
+        close(connection);
+    }
+
+    --s_ActiveSessions;
+}
+
+int YAPLServer::runClient(const std::string &socketPath, const std::string &inputPath) {
+    sockaddr_un address;
+
+    if (!getSocketAddress(socketPath, address)) {
+        std::cerr << "Socket path too long: " << socketPath << std::endl;
+        return 1;
+    }
+
+    int input = inputPath.empty() ? STDIN_FILENO : open(inputPath.c_str(), O_RDONLY);
+
+    if (input < 0) {
+        std::perror(("Failed to open " + inputPath).c_str());
+        return 1;
+    }
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (connection < 0 || connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        std::perror(("Failed to connect to " + socketPath).c_str());
+        return 1;
+    }
+
+    // Reads the input as it comes, a line at a time from a terminal. Detached,
+    // the session may end while stdin is still open.
+    std::thread([input, connection]() {
+        char buffer[4096];
+        ssize_t size;
+
+        while ((size = read(input, buffer, sizeof(buffer))) > 0) {
+            if (!writeAll(connection, buffer, size)) {
+                break;
+            }
+        }
+
+        // The end of the input ends the session.
+        shutdown(connection, SHUT_WR);
+    }).detach();
+
+    char buffer[4096];
+    ssize_t size;
+
+    while ((size = read(connection, buffer, sizeof(buffer))) > 0) {
+        if (!writeAll(STDERR_FILENO, buffer, size)) {
+            break;
+        }
+    }
+
+    close(connection);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "Statistics/Statistics.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+#ifdef YAPL_ENABLE_STATISTICS
+
+static std::mutex &getRegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<const Statistic *> &getRegistry() {
+    static std::vector<const Statistic *> registry;
+    return registry;
+}
+
+Statistic::Statistic(const char *group, const char *name, const char *description)
+    : m_Group(group), m_Name(name), m_Description(description)
+{
+    std::lock_guard lock{getRegistryMutex()};
+    getRegistry().push_back(this);
+}
+
+void Statistics::print(std::ostream &stream) {
+    std::vector<const Statistic *> statistics;
+    {
+        std::lock_guard lock{getRegistryMutex()};
+        statistics = getRegistry();
+    }
+
+    std::stable_sort(statistics.begin(), statistics.end(), [](const Statistic *lhs, const Statistic *rhs) {
+        int groupOrder = std::strcmp(lhs->getGroup(), rhs->getGroup());
+        return groupOrder != 0 ? groupOrder < 0 : std::strcmp(lhs->getName(), rhs->getName()) < 0;
+    });
+
+    stream << "===------------------ YAPL statistics ------------------===" << std::endl;
+    for (const auto *statistic : statistics) {
+        stream << std::right << std::setw(12) << statistic->getValue() << " "
+            << std::left << std::setw(10) << statistic->getGroup() << " - "
+            << statistic->getDescription() << std::endl;
+    }
+    stream << std::right;
+}
+
+#else
+
+void Statistics::print(std::ostream &stream) {
+    stream << "Statistics are disabled, configure with -DYAPL_ENABLE_STATISTICS=ON" << std::endl;
+}
+
+#endif
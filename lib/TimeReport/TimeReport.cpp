@@ -0,0 +1,212 @@
+#include "TimeReport/TimeReport.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+
+static thread_local TimeReport::Scope *s_CurrentScope = nullptr;
+
+static double toMilliseconds(uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1e6;
+}
+
+static uint64_t entryTotal(const std::array<uint64_t, static_cast<size_t>(Phase::Count)> &nanoseconds) {
+    uint64_t total = 0;
+    for (auto ns : nanoseconds) {
+        total += ns;
+    }
+    return total;
+}
+
+TimeReport::Scope::Scope(Phase phase)
+    : m_Phase(phase), m_Active(TimeReport::get().isEnabled()), m_Parent(nullptr)
+{
+    if (!m_Active) {
+        return;
+    }
+
+    m_Parent = s_CurrentScope;
+
+    if (m_Parent) {
+        m_Parent->flush();
+    }
+
+    s_CurrentScope = this;
+    m_Start = Clock::now();
+}
+
+TimeReport::Scope::~Scope() {
+    if (!m_Active) {
+        return;
+    }
+
+    flush();
+    s_CurrentScope = m_Parent;
+
+    if (m_Parent) {
+        m_Parent->m_Start = Clock::now();
+    }
+}
+
+void TimeReport::Scope::flush() {
+    auto now = Clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_Start).count();
+    TimeReport::get().addTime(m_Phase, elapsed);
+    m_Start = now;
+}
+
+TimeReport &TimeReport::get() {
+    static TimeReport report;
+    return report;
+}
+
+void TimeReport::addTime(Phase phase, uint64_t nanoseconds) {
+    if (phase == Phase::Lex) {
+        m_LexNanoseconds += nanoseconds;
+        m_LexCalls++;
+        return;
+    }
+
+    std::lock_guard lock{m_Mutex};
+    m_Current.nanoseconds[static_cast<size_t>(phase)] += nanoseconds;
+}
+
+void TimeReport::endEntry(const std::string &name) {
+    if (!m_Enabled) {
+        return;
+    }
+
+    std::lock_guard lock{m_Mutex};
+    m_Current.name = name;
+    m_Entries.push_back(std::move(m_Current));
+    m_Current = Entry();
+}
+
+const char *TimeReport::phaseToString(Phase phase) {
+    switch (phase) {
+        case Phase::Lex:
+            return "lex";
+        case Phase::Parse:
+            return "parse";
+        case Phase::IRGen:
+            return "irgen";
+        case Phase::Optimize:
+            return "optimize";
+        case Phase::JIT:
+            return "jit";
+        case Phase::Execute:
+            return "execute";
+        default:
+            return "unknown";
+    }
+}
+
+void TimeReport::print(std::ostream &stream) const {
+    std::lock_guard lock{m_Mutex};
+
+    // The lexer is not attributed per declaration, it starts at Parse.
+    constexpr size_t firstPhase = static_cast<size_t>(Phase::Parse);
+    constexpr size_t maxRows = 10;
+
+    Entry aggregate;
+    aggregate.name = "total";
+    for (const auto &entry : m_Entries) {
+        for (size_t i = 0; i < s_PhaseCount; i++) {
+            aggregate.nanoseconds[i] += entry.nanoseconds[i];
+        }
+    }
+
+    std::vector<const Entry *> slowest;
+    for (const auto &entry : m_Entries) {
+        slowest.push_back(&entry);
+    }
+    std::sort(slowest.begin(), slowest.end(), [](const Entry *lhs, const Entry *rhs) {
+        return entryTotal(lhs->nanoseconds) > entryTotal(rhs->nanoseconds);
+    });
+    if (slowest.size() > maxRows) {
+        slowest.resize(maxRows);
+    }
+
+    auto printRow = [&](const Entry &entry) {
+        stream << std::left << std::setw(20) << entry.name.substr(0, 19) << std::right;
+        for (size_t i = firstPhase; i < s_PhaseCount; i++) {
+            stream << std::setw(11) << toMilliseconds(entry.nanoseconds[i]);
+        }
+        stream << std::setw(11) << toMilliseconds(entryTotal(entry.nanoseconds)) << std::endl;
+    };
+
+    stream << "===------------------ YAPL time report (ms) ------------------===" << std::endl;
+    stream << std::left << std::setw(20) << "declaration" << std::right;
+    for (size_t i = firstPhase; i < s_PhaseCount; i++) {
+        stream << std::setw(11) << phaseToString(static_cast<Phase>(i));
+    }
+    stream << std::setw(11) << "total" << std::endl;
+
+    stream << std::fixed << std::setprecision(3);
+    for (const auto *entry : slowest) {
+        printRow(*entry);
+    }
+    if (m_Entries.size() > maxRows) {
+        stream << "(" << m_Entries.size() - maxRows << " faster declarations not shown)" << std::endl;
+    }
+    printRow(aggregate);
+
+    stream << "lex: " << toMilliseconds(m_LexNanoseconds) << " ms over "
+        << m_LexCalls << " tokens (on the IO thread, overlaps parse)" << std::endl;
+    stream << std::defaultfloat;
+}
+
+bool TimeReport::writeJSON(const std::string &path) const {
+    std::error_code errorCode;
+    llvm::raw_fd_ostream stream(path, errorCode, llvm::sys::fs::OF_Text);
+
+    if (errorCode) {
+        std::fprintf(stderr, "Failed to open time report file %s: %s\n",
+                path.c_str(), errorCode.message().c_str());
+        return false;
+    }
+
+    std::lock_guard lock{m_Mutex};
+
+    auto writePhases = [&](const Entry &entry) {
+        for (size_t i = 0; i < s_PhaseCount; i++) {
+            if (i != 0) {
+                stream << ", ";
+            }
+            stream << "\"" << phaseToString(static_cast<Phase>(i)) << "\": "
+                << toMilliseconds(entry.nanoseconds[i]);
+        }
+    };
+
+    Entry aggregate;
+    for (const auto &entry : m_Entries) {
+        for (size_t i = 0; i < s_PhaseCount; i++) {
+            aggregate.nanoseconds[i] += entry.nanoseconds[i];
+        }
+    }
+    aggregate.nanoseconds[static_cast<size_t>(Phase::Lex)] = m_LexNanoseconds;
+
+    stream << "{\n  \"unit\": \"ms\",\n  \"tokens\": " << m_LexCalls.load() << ",\n";
+    stream << "  \"total\": { ";
+    writePhases(aggregate);
+    stream << " },\n  \"declarations\": [";
+
+    for (size_t i = 0; i < m_Entries.size(); i++) {
+        stream << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"";
+        stream.write_escaped(m_Entries[i].name);
+        stream << "\", ";
+        writePhases(m_Entries[i]);
+        stream << " }";
+    }
+
+    // LLVM's own timers (-time-passes) are dumped as flat key/values.
+    stream << "\n  ],\n  \"llvm\": {";
+    llvm::TimerGroup::printAllJSONValues(stream, "\n");
+    stream << "\n  }\n}\n";
+
+    return true;
+}
@@ -0,0 +1,72 @@
+#include "YAPLJIT/PerfMapListener.hpp"
+
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Process.h>
+
+#include <string>
+
+PerfMapListener::PerfMapListener() {
+    std::string path = "/tmp/perf-" + std::to_string(llvm::sys::Process::getProcessId()) + ".map";
+
+    m_File = std::fopen(path.c_str(), "w");
+
+    if (!m_File) {
+        std::string str("Failed to open perf map: ");
+        str += path;
+        std::perror(str.c_str());
+    }
+}
+
+PerfMapListener::~PerfMapListener() {
+    if (m_File) {
+        std::fclose(m_File);
+    }
+}
+
+void PerfMapListener::notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile &object,
+                                         const llvm::RuntimeDyld::LoadedObjectInfo &loadedObject) {
+    if (!m_File) {
+        return;
+    }
+
+    // The debug object has its sections relocated to their load addresses.
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debugObjectOwner = loadedObject.getObjectForDebug(object);
+    const llvm::object::ObjectFile *debugObject = debugObjectOwner.getBinary();
+
+    if (!debugObject) {
+        return;
+    }
+
+    std::lock_guard lock{m_Mutex};
+
+    for (const auto &symbolAndSize : llvm::object::computeSymbolSizes(*debugObject)) {
+        const llvm::object::SymbolRef &symbol = symbolAndSize.first;
+
+        auto typeOrErr = symbol.getType();
+        if (!typeOrErr) {
+            llvm::consumeError(typeOrErr.takeError());
+            continue;
+        }
+
+        if (*typeOrErr != llvm::object::SymbolRef::ST_Function) {
+            continue;
+        }
+
+        auto nameOrErr = symbol.getName();
+        auto addressOrErr = symbol.getAddress();
+
+        if (!nameOrErr || !addressOrErr) {
+            llvm::consumeError(nameOrErr.takeError());
+            llvm::consumeError(addressOrErr.takeError());
+            continue;
+        }
+
+        std::fprintf(m_File, "%llx %llx %s\n",
+                static_cast<unsigned long long>(*addressOrErr),
+                static_cast<unsigned long long>(symbolAndSize.second),
+                nameOrErr->str().c_str());
+    }
+
+    std::fflush(m_File);
+}
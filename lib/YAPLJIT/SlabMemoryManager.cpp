@@ -0,0 +1,178 @@
+#include "YAPLJIT/SlabMemoryManager.hpp"
+
+#include <algorithm>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/Process.h>
+
+#include "Statistics/Statistics.hpp"
+
+YAPL_STATISTIC(NumSlabs, "jit", "Slabs mapped by the JITLink memory manager");
+YAPL_STATISTIC(NumSlabAllocations, "jit", "Objects allocated by the JITLink memory manager");
+YAPL_STATISTIC(NumSlabCodeBytes, "jit", "Bytes of JITLink code memory");
+YAPL_STATISTIC(NumSlabDataBytes, "jit", "Bytes of JITLink data memory");
+
+using ProtectionFlags = llvm::sys::Memory::ProtectionFlags;
+
+static constexpr unsigned s_ReadWrite = llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE;
+
+class SlabAllocation : public llvm::jitlink::JITLinkMemoryManager::Allocation {
+private:
+    size_t m_PageSize;
+    llvm::DenseMap<unsigned, llvm::sys::MemoryBlock> m_Segments;
+
+public:
+    SlabAllocation(size_t pageSize)
+        : m_PageSize(pageSize)
+    {}
+
+    void addSegment(unsigned protection, char *memory, size_t size) {
+        m_Segments[protection] = llvm::sys::MemoryBlock(memory, size);
+    }
+
+    llvm::MutableArrayRef<char> getWorkingMemory(ProtectionFlags segment) override {
+        auto &block = m_Segments[segment];
+        return { static_cast<char *>(block.base()), static_cast<size_t>(block.allocatedSize()) };
+    }
+
+    llvm::JITTargetAddress getTargetMemory(ProtectionFlags segment) override {
+        return llvm::pointerToJITTargetAddress(m_Segments[segment].base());
+    }
+
+    void finalizeAsync(FinalizeContinuation onFinalize) override {
+        for (auto &segment : m_Segments) {
+            if (segment.first == s_ReadWrite) {
+                continue;
+            }
+
+            // Page allocations: the whole pages belong to this segment.
+            llvm::sys::MemoryBlock pages(segment.second.base(),
+                    llvm::alignTo(segment.second.allocatedSize(), m_PageSize));
+
+            if (auto errorCode = llvm::sys::Memory::protectMappedMemory(pages, segment.first)) {
+                onFinalize(llvm::errorCodeToError(errorCode));
+                return;
+            }
+
+            if (segment.first & llvm::sys::Memory::MF_EXEC) {
+                llvm::sys::Memory::InvalidateInstructionCache(pages.base(), pages.allocatedSize());
+            }
+        }
+
+        onFinalize(llvm::Error::success());
+    }
+
+    llvm::Error deallocate() override {
+        // Released with the slabs.
+        return llvm::Error::success();
+    }
+};
+
+SlabMemoryManager::SlabMemoryManager(size_t slabSize)
+    : m_PageSize(llvm::sys::Process::getPageSizeEstimate())
+{
+    m_SlabSize = llvm::alignTo(slabSize, m_PageSize);
+}
+
+SlabMemoryManager::~SlabMemoryManager() {
+    for (auto &slab : m_Slabs) {
+        llvm::sys::Memory::releaseMappedMemory(slab);
+    }
+}
+
+// Start of the data of the given size packed below the data of the slab.
+static char *dataStart(char *data, size_t size, size_t alignment) {
+    return reinterpret_cast<char *>(llvm::alignDown(reinterpret_cast<uintptr_t>(data) - size, alignment));
+}
+
+llvm::Error SlabMemoryManager::reserve(size_t pageBytes, size_t dataBytes, size_t dataAlignment) {
+    // Both checks keep the addresses from wrapping around.
+    if (m_Current.pages && pageBytes + dataBytes <= static_cast<size_t>(m_Current.data - m_Current.pages) &&
+            m_Current.pages + pageBytes <= dataStart(m_Current.data, dataBytes, dataAlignment)) {
+        return llvm::Error::success();
+    }
+
+    std::error_code errorCode;
+    // Oversized requests get a slab of their own.
+    size_t slabSize = std::max(m_SlabSize,
+            static_cast<size_t>(llvm::alignTo(pageBytes + dataBytes + dataAlignment, m_PageSize)));
+
+    // Mapping is lazy: untouched pages of the slab are not resident.
+    auto slab = llvm::sys::Memory::allocateMappedMemory(slabSize, nullptr, s_ReadWrite, errorCode);
+
+    if (errorCode) {
+        return llvm::errorCodeToError(errorCode);
+    }
+
+    ++NumSlabs;
+    m_Slabs.push_back(slab);
+
+    m_Current.pages = static_cast<char *>(slab.base());
+    m_Current.data = m_Current.pages + slab.allocatedSize();
+
+    return llvm::Error::success();
+}
+
+llvm::Expected<std::unique_ptr<llvm::jitlink::JITLinkMemoryManager::Allocation>>
+SlabMemoryManager::allocate(const SegmentsRequestMap &request) {
+    auto allocation = std::make_unique<SlabAllocation>(m_PageSize);
+
+    size_t pageBytes = 0;
+    size_t dataBytes = 0;
+    size_t dataAlignment = 1;
+
+    for (const auto &segment : request) {
+        const auto &segmentRequest = segment.second;
+
+        if (segmentRequest.getAlignment() > m_PageSize) {
+            return llvm::make_error<llvm::StringError>("Cannot request higher than page alignment",
+                    llvm::inconvertibleErrorCode());
+        }
+
+        // Every segment needs its own address, even when empty.
+        size_t size = std::max<size_t>(segmentRequest.getContentSize() + segmentRequest.getZeroFillSize(), 1);
+
+        if (segment.first == s_ReadWrite) {
+            dataBytes = size;
+            dataAlignment = std::max<size_t>(segmentRequest.getAlignment(), 1);
+        } else {
+            pageBytes += llvm::alignTo(size, m_PageSize);
+        }
+    }
+
+    std::lock_guard lock{m_Mutex};
+
+    if (auto error = reserve(pageBytes, dataBytes, dataAlignment)) {
+        return error;
+    }
+
+    for (const auto &segment : request) {
+        unsigned protection = segment.first;
+        const auto &segmentRequest = segment.second;
+        size_t size = std::max<size_t>(segmentRequest.getContentSize() + segmentRequest.getZeroFillSize(), 1);
+        char *memory;
+
+        if (protection == s_ReadWrite) {
+            memory = m_Current.data = dataStart(m_Current.data, size, dataAlignment);
+            NumSlabDataBytes += size;
+        } else {
+            memory = m_Current.pages;
+            m_Current.pages += llvm::alignTo(size, m_PageSize);
+
+            if (protection & llvm::sys::Memory::MF_EXEC) {
+                NumSlabCodeBytes += size;
+            } else {
+                NumSlabDataBytes += size;
+            }
+        }
+
+        // Slab memory is never reused, freshly mapped pages are already zero-filled.
+        allocation->addSegment(protection, memory, size);
+    }
+
+    ++NumSlabAllocations;
+
+    return std::move(allocation);
+}
@@ -1,22 +1,158 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <string>
 
 #include "AST/ExprAST.hpp"
 #include "IRGenerator/IRGenerator.hpp"
 #include "Lexer/Lexer.hpp"
+#include "Logger/Logger.hpp"
 #include "Parser/Parser.hpp"
+#include "Server/YAPLServer.hpp"
+#include "TimeReport/TimeReport.hpp"
+#include "utils/options.hpp"
+
+// Largest --memo-size, each entry takes 16 bytes plus 8 per argument.
+static constexpr unsigned long s_MaxMemoSize = 1 << 20;
+
+static void printUsage(const char *program) {
+    std::cerr << "Usage: " << program << " [options] [file]" << std::endl
+        << "Options:" << std::endl
+        << "  --time-report              Print the time spent in each compilation phase" << std::endl
+        << "  --time-report-json=<file>  Also write the time report as JSON to <file>" << std::endl
+        << "  --quiet, -q                Only print the results of the top level expressions and the errors" << std::endl
+        << "  --log-level=<level>        Print 'error' messages only, 'info' (same as --quiet) or 'debug' (default)" << std::endl
+        << "  --stats                    Print the compiler statistics at exit" << std::endl
+        << "  --perf-map                 Write JIT symbols to /tmp/perf-<pid>.map" << std::endl
+        << "  --perf-jitdump             Write a jitdump file for `perf inject --jit`" << std::endl
+        << "  --gdb-jit                  Register JIT objects to GDB's JIT interface" << std::endl
+        << "  -g                         Emit debug line tables for the JIT compiled code" << std::endl
+        << "  --profile                  Sample the JIT compiled code and print the hottest lines at exit" << std::endl
+        << "  --jit-linker=<linker>      Link JIT objects with 'rtdyld' (default) or 'jitlink'" << std::endl
+        << "  --fp-contract              Allow fusing floating point a * b + c into fma" << std::endl
+        << "  --fast-math                Allow all fast-math optimizations, see the README" << std::endl
+        << "  --whole-program            Only compile the functions reachable from the top level expressions" << std::endl
+        << "  --cache                    Read the parsed file from <file>c when it did not change" << std::endl
+        << "  --memo-size=<n>            Entries of the result table of each pure function, up to 2^20, 0 disables it" << std::endl
+        << "  --no-fold-calls            Run calls of constant arguments instead of folding them" << std::endl
+        << "  --bench=<call>             Time a call such as 'f(1, 2.5)' once the input ran" << std::endl
+        << "  --emit-bc=<file>           Write the optimized code to the LLVM bitcode <file> at exit" << std::endl
+        << "  --load-bc=<file>           Load and run a bitcode <file> written by --emit-bc before the input" << std::endl
+        << "  --server=<socket>          Serve a REPL session to each client of the Unix <socket>" << std::endl
+        << "  --connect=<socket>         Run the input in a session of the server listening on <socket>" << std::endl;
+}
+
+static bool parseArguments(int argc, char* argv[], Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--time-report") {
+            options.timeReport = true;
+        } else if (arg.rfind("--time-report-json=", 0) == 0) {
+            options.timeReport = true;
+            options.timeReportJSON = arg.substr(std::strlen("--time-report-json="));
+        } else if (arg == "--quiet" || arg == "-q") {
+            Logger::setLevel(LogLevel::Info);
+        } else if (arg == "--log-level=error") {
+            Logger::setLevel(LogLevel::Error);
+        } else if (arg == "--log-level=info") {
+            Logger::setLevel(LogLevel::Info);
+        } else if (arg == "--log-level=debug") {
+            Logger::setLevel(LogLevel::Debug);
+        } else if (arg == "--stats") {
+            options.statistics = true;
+        } else if (arg == "--perf-map") {
+            options.perfMap = true;
+        } else if (arg == "--perf-jitdump") {
+            options.perfJitDump = true;
+        } else if (arg == "--gdb-jit") {
+            options.gdbJIT = true;
+        } else if (arg == "-g") {
+            options.debugInfo = true;
+        } else if (arg == "--profile") {
+            options.profile = true;
+            options.debugInfo = true;
+        } else if (arg == "--jit-linker=rtdyld") {
+            options.jitLinker = JITLinker::RTDyld;
+        } else if (arg == "--jit-linker=jitlink") {
+            options.jitLinker = JITLinker::JITLink;
+        } else if (arg == "--fp-contract") {
+            options.fpMode = FPMode::Contract;
+        } else if (arg == "--fast-math") {
+            options.fpMode = FPMode::Fast;
+        } else if (arg == "--whole-program") {
+            options.wholeProgram = true;
+        } else if (arg == "--cache") {
+            options.astCache = true;
+        } else if (arg.rfind("--memo-size=", 0) == 0) {
+            const char *value = arg.c_str() + std::strlen("--memo-size=");
+            char *end = nullptr;
+            unsigned long memoSize = std::strtoul(value, &end, 10);
+
+            // strtoul skips spaces, accepts a sign and saturates on overflow.
+            if (!std::isdigit(static_cast<unsigned char>(*value)) || *end != '\0' || memoSize > s_MaxMemoSize) {
+                std::cerr << "Expected a number of entries up to " << s_MaxMemoSize << ": " << arg << std::endl;
+                return false;
+            }
+
+            options.memoSize = memoSize;
+        } else if (arg == "--no-fold-calls") {
+            options.foldCalls = false;
+        } else if (arg.rfind("--bench=", 0) == 0) {
+            options.benchCall = arg.substr(std::strlen("--bench="));
+        } else if (arg.rfind("--emit-bc=", 0) == 0) {
+            options.emitBitcode = arg.substr(std::strlen("--emit-bc="));
+        } else if (arg.rfind("--load-bc=", 0) == 0) {
+            options.loadBitcode = arg.substr(std::strlen("--load-bc="));
+        } else if (arg.rfind("--server=", 0) == 0) {
+            options.serverSocket = arg.substr(std::strlen("--server="));
+        } else if (arg.rfind("--connect=", 0) == 0) {
+            options.connectSocket = arg.substr(std::strlen("--connect="));
+        } else if (arg.rfind("-", 0) == 0 || !options.inputPath.empty()) {
+            std::cerr << "Unexpected argument: " << arg << std::endl;
+            return false;
+        } else {
+            options.inputPath = arg;
+        }
+    }
+
+    return true;
+}
 
 int main(int argc, char* argv[]) {
+    Options options;
 
-    std::cerr << "YAPL v 0.0.3" << std::endl;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
 
-    if (argc < 2) {
-        IRGenerator generator("");
-        generator.generate();
-    } else {
-        IRGenerator generator(argv[1]);
-        generator.generate();
+    if (!options.connectSocket.empty()) {
+        return YAPLServer::runClient(options.connectSocket, options.inputPath);
     }
 
+    YAPL_LOG(Debug) std::cerr << "YAPL v 0.0.3" << std::endl;
+
+    if (options.timeReport) {
+        TimeReport::get().enable();
+    }
+
+    if (!options.serverSocket.empty()) {
+        YAPLServer server(options, options.serverSocket);
+
+        if (auto error = server.listen()) {
+            llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "Failed to start the server: ");
+            return 1;
+        }
+
+        server.serve();
+        return 1;
+    }
+
+    IRGenerator generator(options);
+    generator.generate();
+
     return 0;
 }
@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+#
+# Writes the code of test/bitcode.yapl with --emit-bc, then loads it to run
+# test/bitcode_redefine.yapl, which redefines one of its functions: the
+# callers compiled in the bitcode must follow the new definition.
+#
+# Usage: test/bitcode.sh <path to yapl>
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl>}
+DIR=$(dirname "$0")
+
+BITCODE=$(mktemp)
+trap 'rm -f "$BITCODE"' EXIT
+
+# The first line is the top level expression of bitcode.yapl, run by --load-bc.
+EXPECTED="Evaluated to 285
+Evaluated to 285
+Evaluated to 2025
+Evaluated to 27"
+
+"$YAPL" -q --emit-bc="$BITCODE" "$DIR/bitcode.yapl" > /dev/null 2>&1
+actual=$("$YAPL" -q --load-bc="$BITCODE" "$DIR/bitcode_redefine.yapl" 2>&1)
+
+if [ "$actual" != "$EXPECTED" ]; then
+    echo "bitcode_redefine.yapl: expected"
+    echo "$EXPECTED"
+    echo "got"
+    echo "$actual"
+    exit 1
+fi
+
+echo "bitcode_redefine.yapl: ok"
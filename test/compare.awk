@@ -0,0 +1,33 @@
+#
+# Compares its input with the lines of expectedFile, see test/expect.sh, and
+# prints the first mismatch, or nothing.
+#
+# Usage: awk -v expectedFile=<file> -f test/compare.awk <output>
+#
+
+function abs(x) { return x < 0 ? -x : x }
+
+{
+    if ((getline expected < expectedFile) <= 0) {
+        printf "unexpected line %d: %s\n", NR, $0
+        exit
+    }
+
+    n = split(expected, words, " ")
+
+    if (n == 5 && words[1] == "Evaluated" && words[4] == "+-") {
+        if ($1 != "Evaluated" || NF != 3 || abs($3 - words[3]) > words[5]) {
+            printf "line %d: expected %s, got %s\n", NR, expected, $0
+            exit
+        }
+    } else if ($0 != expected) {
+        printf "line %d: expected %s, got %s\n", NR, expected, $0
+        exit
+    }
+}
+
+END {
+    if ((getline expected < expectedFile) > 0) {
+        printf "missing line %d: %s\n", NR + 1, expected
+    }
+}
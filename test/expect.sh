@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+#
+# Runs a test script and compares what it prints with <script>.expected,
+# with the calls evaluated at compile time and at run time.
+#
+# Each line of the expected file is either the exact line printed, or
+# "Evaluated to <value> +- <tolerance>" for a result whose last digits depend
+# on the host, such as a float sum reassociated by --fast-math or a parallel
+# loop.
+#
+# Usage: test/expect.sh <path to yapl> <script.yapl>
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl> <script.yapl>}
+SOURCE=${2:?usage: $0 <path to yapl> <script.yapl>}
+EXPECTED=${SOURCE%.yapl}.expected
+
+ACTUAL=$(mktemp)
+trap 'rm -f "$ACTUAL"' EXIT
+
+for flags in "" "--no-fold-calls"; do
+    # shellcheck disable=SC2086
+    "$YAPL" -q $flags "$SOURCE" > "$ACTUAL" 2>&1
+    mismatch=$(awk -v expectedFile="$EXPECTED" -f "$(dirname "$0")/compare.awk" "$ACTUAL")
+
+    if [ -n "$mismatch" ]; then
+        echo "$(basename "$SOURCE") ${flags:-with folding}: $mismatch"
+        exit 1
+    fi
+done
+
+echo "$(basename "$SOURCE"): ok"
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+#
+# Runs test/recursion.yapl with a 1 MB stack: its recursions are 10^7 calls
+# deep and only complete once compiled to loops. Checks the printed values,
+# with the calls evaluated at compile time and at run time.
+#
+# Usage: test/recursion.sh <path to yapl>
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl>}
+SOURCE=$(dirname "$0")/recursion.yapl
+
+EXPECTED="Evaluated to 4982476
+Evaluated to 1"
+
+ulimit -s 1024
+
+for flags in "" "--no-fold-calls"; do
+    # shellcheck disable=SC2086
+    actual=$("$YAPL" -q $flags "$SOURCE" 2>&1)
+
+    if [ "$actual" != "$EXPECTED" ]; then
+        echo "recursion.yapl ${flags:-with folding}: expected"
+        echo "$EXPECTED"
+        echo "got"
+        echo "$actual"
+        exit 1
+    fi
+done
+
+echo "recursion.yapl: ok"
@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+#
+# Starts a yapl server and runs test/parallel.yapl and test/redefine.yapl as
+# two clients at once: the functions of one session may be compiled by the
+# threads of the other's parallel loops. Checks what each client prints
+# against its .expected file, as test/expect.sh does.
+#
+# Usage: test/server.sh <path to yapl>
+#
+
+set -euo pipefail
+
+YAPL=${1:?usage: $0 <path to yapl>}
+DIR=$(dirname "$0")
+
+WORKDIR=$(mktemp -d)
+SOCKET=$WORKDIR/yapl.sock
+SERVER=
+
+cleanup() {
+    [ -n "$SERVER" ] && kill "$SERVER" 2>/dev/null
+    rm -rf "$WORKDIR"
+}
+trap cleanup EXIT
+
+"$YAPL" -q --server="$SOCKET" 2>/dev/null &
+SERVER=$!
+
+for ((i = 0; i < 100; i++)); do
+    [ -S "$SOCKET" ] && break
+    sleep 0.05
+done
+
+SCRIPTS="parallel redefine"
+CLIENTS=
+
+for script in $SCRIPTS; do
+    "$YAPL" --connect="$SOCKET" "$DIR/$script.yapl" > "$WORKDIR/$script.out" 2>&1 &
+    CLIENTS="$CLIENTS $!"
+done
+
+# shellcheck disable=SC2086
+wait $CLIENTS
+
+for script in $SCRIPTS; do
+    # The session prints the prompts of the REPL.
+    sed 's/(YAPL)>>>//g; /^$/d' "$WORKDIR/$script.out" > "$WORKDIR/$script.actual"
+    mismatch=$(awk -v expectedFile="$DIR/$script.expected" -f "$DIR/compare.awk" "$WORKDIR/$script.actual")
+
+    if [ -n "$mismatch" ]; then
+        echo "$script.yapl through the server: $mismatch"
+        exit 1
+    fi
+done
+
+echo "server: ok"